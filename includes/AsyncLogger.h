@@ -0,0 +1,78 @@
+#pragma once
+#include "vqjs-modules.h"
+#include "vqjs.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace VQJS {
+
+// Logger that only copies the line into a preallocated ring and lets a
+// background thread do the formatting and writing. Meant for console.* in
+// hot paths, use it with Runtime::SetLogger.
+// Lines are written to sink if there is one, stdout/stderr otherwise.
+// If the ring is full lines are dropped instead of blocking the caller.
+struct AsyncLogger final : Logger {
+  static constexpr size_t SlotCount = 4096;
+  static constexpr size_t SlotSize = 240;
+  // longer lines take consecutive slots, anything past this is cut off
+  static constexpr size_t MaxSlotsPerLine = 16;
+  static constexpr size_t MaxLineSize = SlotSize * MaxSlotsPerLine;
+
+  explicit AsyncLogger(
+      Ref<Logger> sink = nullptr,
+      std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+  ~AsyncLogger() override;
+  AsyncLogger(const AsyncLogger &) = delete;
+
+  void Info(const std::string &lines) override;
+  void Debug(const std::string &lines) override;
+  void Error(const std::string &lines) override;
+  void Warn(const std::string &lines) override;
+  void Log(Level level, std::string_view line) override;
+
+  // Blocks until everything logged so far is written
+  void Flush();
+  [[nodiscard]] size_t Dropped() const { return m_Dropped; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> Sequence{0};
+    Level Severity{Level::Info};
+    // of the whole line, only set in its first slot
+    uint32_t Size{0};
+    char Data[SlotSize]{};
+  };
+
+  void Run();
+  // returns the number of written lines
+  size_t Drain();
+  void Write(Level level, std::string_view line);
+
+  std::unique_ptr<Slot[]> m_Slots;
+  alignas(64) std::atomic<size_t> m_Tail{0};
+  alignas(64) std::atomic<size_t> m_Head{0};
+  std::atomic<size_t> m_Dropped{0};
+  std::atomic<bool> m_Urgent{false};
+
+  Ref<Logger> m_Sink{};
+  std::chrono::milliseconds m_Interval;
+  std::string m_Out{};
+  std::string m_Err{};
+  // lines spanning several slots are put back together here
+  std::string m_Line{};
+
+  std::mutex m_Mutex{};
+  std::condition_variable m_Wake{};
+  std::condition_variable m_Drained{};
+  bool m_Stop{false};
+  std::thread m_Thread{};
+};
+} // namespace VQJS
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace VQJS {
+// Size-classed pool for ArrayBuffer backing stores.
+// Buffers are 64-byte aligned (page aligned from LargeSize on), so native
+// kernels can use aligned SIMD loads on them.
+struct BufferPool {
+  static constexpr size_t Alignment = 64;
+  static constexpr size_t PageSize = 4096;
+  static constexpr size_t LargeSize = 64 * 1024;
+  // everything above is allocated and freed directly
+  static constexpr size_t MaxPooledSize = 16 * 1024 * 1024;
+  // upper bound for memory kept around in the free lists
+  static constexpr size_t MaxCachedBytes = 64 * 1024 * 1024;
+
+  static BufferPool &Get();
+
+  // Buffers are reference counted, Allocate hands out the first reference
+  [[nodiscard]] uint8_t *Allocate(size_t bytes, bool zeroed = true);
+  void Retain(uint8_t *buffer);
+  void Release(uint8_t *buffer);
+  // Frees all cached buffers
+  void Trim();
+  // False for memory that didn't come from Allocate, those must not be
+  // retained or released
+  [[nodiscard]] bool Owns(const uint8_t *buffer) const;
+
+  [[nodiscard]] size_t CachedBytes() const;
+  // Handed out and not released yet
+  [[nodiscard]] size_t LiveBuffers() const;
+  [[nodiscard]] static size_t Capacity(const uint8_t *buffer);
+
+  BufferPool() = default;
+  BufferPool(const BufferPool &) = delete;
+
+private:
+  static constexpr size_t MinShift = 6;
+  static constexpr size_t MaxShift = 24;
+  static constexpr size_t ClassCount = MaxShift - MinShift + 1;
+
+  void FreeBlock(uint8_t *buffer);
+
+  std::vector<uint8_t *> m_Free[ClassCount];
+  size_t m_CachedBytes{0};
+  size_t m_CachedCount{0};
+  // every block we allocated, cached ones included
+  std::unordered_set<const uint8_t *> m_Blocks{};
+  mutable std::mutex m_Mutex;
+};
+} // namespace VQJS
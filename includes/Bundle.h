@@ -0,0 +1,63 @@
+#pragma once
+#include "File.h"
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VQJS {
+
+// Bytecode of a whole module graph in one file, written by
+// Runtime::WriteBundle (see the vqjs-bundle tool) and mapped by
+// Runtime::LoadBundle. Modules are found by the name the loader gets for
+// them, so the ModuleLoader paths have to be the same as when it was
+// written. Layout (native endianness):
+//   Header | Entry[Count] sorted by name | names | bytecode
+struct Bundle {
+  static constexpr uint32_t Magic = 0x424a5156; // VQJB
+  static constexpr uint32_t Version = 1;
+  // Header::Flags, how the bytecode got written
+  static constexpr uint32_t StripSource = 1 << 0;
+  static constexpr uint32_t StripDebug = 1 << 1;
+
+  struct Header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Count;
+    uint32_t Flags;
+  };
+  struct Entry {
+    uint32_t NameOffset;
+    uint32_t NameSize;
+    uint32_t DataOffset;
+    uint32_t DataSize;
+  };
+
+  // Maps the file and checks the index, fails on anything unexpected
+  bool Open(const std::string &file);
+  // Empty if the bundle doesn't contain name
+  [[nodiscard]] std::span<const uint8_t> Find(std::string_view name) const;
+  [[nodiscard]] uint32_t Count() const { return m_Count; }
+  [[nodiscard]] uint32_t Flags() const { return m_Flags; }
+
+private:
+  [[nodiscard]] std::string_view Name(const Entry &entry) const;
+
+  MappedFile m_File{};
+  const Entry *m_Entries{nullptr};
+  uint32_t m_Count{0};
+  uint32_t m_Flags{0};
+};
+// Collects modules and writes them as Bundle
+struct BundleWriter {
+  void Add(const std::string &name, const uint8_t *data, size_t size);
+  [[nodiscard]] size_t Count() const { return m_Modules.size(); }
+  bool Write(const std::string &file, uint32_t flags = 0) const;
+
+private:
+  std::map<std::string, std::vector<uint8_t>, std::less<>> m_Modules{};
+};
+} // namespace VQJS
@@ -0,0 +1,124 @@
+#pragma once
+#include "vqjs.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VQJS {
+
+// Type erased part of a ClassBinding, shared by all objects of the class
+struct ClassDefinition {
+  typedef std::function<Value(void *, const Value &,
+                              const std::vector<Value> &)>
+      Method;
+  typedef std::function<Value(void *, const Value &)> Getter;
+  typedef std::function<void(void *, const Value &, const Value &)> Setter;
+  typedef std::function<Ref<void>(const Value &, const std::vector<Value> &)>
+      Factory;
+
+  struct MethodEntry {
+    std::string Name;
+    Method Call;
+    size_t Args;
+  };
+  struct PropertyEntry {
+    std::string Name;
+    Getter Get;
+    Setter Set;
+  };
+
+  std::string Name;
+  std::vector<MethodEntry> Methods{};
+  std::vector<PropertyEntry> Properties{};
+  Factory Construct{};
+  std::function<void(void *)> Finalize{};
+};
+
+struct ClassBindingBase {
+  // Function that can be used with `new` from JS, needs SetConstructor
+  [[nodiscard]] Value Constructor(Instance &instance) const;
+
+protected:
+  explicit ClassBindingBase(std::string name);
+  Value Wrap(Instance &instance, void *object, Ref<void> owner) const;
+  [[nodiscard]] void *Unwrap(const Value &value) const;
+  uint32_t Register(Instance &instance) const;
+
+  Ref<ClassDefinition> m_Definition;
+};
+
+// Exposes a C++ type to JS with one JSClassID per runtime. Methods and
+// properties live on a single shared prototype per Context, objects only
+// carry the pointer. Everything has to be added before the first object is
+// created.
+template <typename T> struct ClassBinding : ClassBindingBase {
+  typedef std::function<Value(T &, const Value &, const std::vector<Value> &)>
+      Method;
+  typedef std::function<Value(T &, const Value &)> Getter;
+  typedef std::function<void(T &, const Value &, const Value &)> Setter;
+  typedef std::function<Ref<T>(const Value &, const std::vector<Value> &)>
+      Factory;
+
+  explicit ClassBinding(std::string name)
+      : ClassBindingBase(std::move(name)) {}
+
+  ClassBinding &AddMethod(const std::string &name, Method method,
+                          const size_t args = 0) {
+    m_Definition->Methods.push_back(
+        {name,
+         [method](void *self, const Value &_, const std::vector<Value> &a) {
+           return method(*static_cast<T *>(self), _, a);
+         },
+         args});
+    return *this;
+  }
+
+  ClassBinding &AddProperty(const std::string &name, Getter getter,
+                            Setter setter = {}) {
+    ClassDefinition::Setter set{};
+    if (setter) {
+      set = [setter](void *self, const Value &_, const Value &value) {
+        setter(*static_cast<T *>(self), _, value);
+      };
+    }
+    m_Definition->Properties.push_back(
+        {name,
+         [getter](void *self, const Value &_) {
+           return getter(*static_cast<T *>(self), _);
+         },
+         set});
+    return *this;
+  }
+
+  ClassBinding &SetConstructor(Factory factory) {
+    m_Definition->Construct = [factory](const Value &_,
+                                        const std::vector<Value> &args) {
+      return std::static_pointer_cast<void>(factory(_, args));
+    };
+    return *this;
+  }
+
+  // Called when JS collects an object, before the reference is dropped.
+  // Don't touch any JS values in here, it runs inside the GC.
+  ClassBinding &OnFinalize(std::function<void(T &)> finalize) {
+    m_Definition->Finalize = [finalize](void *self) {
+      finalize(*static_cast<T *>(self));
+    };
+    return *this;
+  }
+
+  // JS keeps the object alive until it is collected
+  [[nodiscard]] Value New(Instance &instance, const Ref<T> &object) const {
+    return Wrap(instance, object.get(), object);
+  }
+  // Non owning, the object has to outlive the JS value
+  [[nodiscard]] Value New(Instance &instance, T *object) const {
+    return Wrap(instance, object, nullptr);
+  }
+  // nullptr if the value is not an object of this class
+  [[nodiscard]] T *Get(const Value &value) const {
+    return static_cast<T *>(Unwrap(value));
+  }
+};
+} // namespace VQJS
@@ -0,0 +1,55 @@
+#pragma once
+#include "vqjs.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VQJS {
+
+// Batched JS -> native calls. Scripts encode commands through a generated
+// encoder (one method per registered command) into a growable
+// SharedArrayBuffer, native code drains it once per frame.
+// Every slot is a double: [opcode, arg0, arg1, ...]
+struct CommandBuffer {
+  struct Args {
+    const double *Data{nullptr};
+    uint32_t Count{0};
+    double operator[](const size_t index) const {
+      assert(index < Count);
+      return Data[index];
+    }
+    template <typename T> [[nodiscard]] T As(const size_t index) const {
+      return static_cast<T>((*this)[index]);
+    }
+  };
+  typedef std::function<void(const Args &)> Decoder;
+
+  // capacity is in slots and only the starting point, the encoder grows
+  explicit CommandBuffer(size_t capacity = 4096);
+
+  static constexpr uint32_t InvalidOpcode = UINT32_MAX;
+
+  // Opcodes are handed out in registration order. Name has to be an ASCII
+  // identifier, it becomes the encoder method. Anything else (or a name
+  // that is taken) gives InvalidOpcode.
+  uint32_t Register(const std::string &name, uint32_t argCount,
+                    Decoder decoder);
+  // Has to be called after all Register calls (and again after a Reset)
+  Value CreateEncoder(Instance &instance);
+  // Decoders must not encode new commands. Returns the decoded commands.
+  // An encoder of a previous Context (Reset) is dropped without decoding.
+  size_t Drain(Instance &instance);
+
+private:
+  struct Command {
+    std::string Name;
+    uint32_t ArgCount;
+    Decoder Decode;
+  };
+  std::vector<Command> m_Commands{};
+  Value m_Encoder{};
+  size_t m_Capacity;
+};
+} // namespace VQJS
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+
+struct JSContext;
+struct JSModuleDef;
+
+// Vectorized kernels behind the "vqjs:dsp" module, usable from native code
+// as well. Pointers don't need any alignment, out may alias the inputs.
+namespace VQJS::DSP {
+double Sum(const double *a, size_t size);
+double Rms(const double *a, size_t size);
+double Peak(const double *a, size_t size);
+void Add(double *out, const double *a, const double *b, size_t size);
+void Add(double *out, const double *a, double b, size_t size);
+void Mul(double *out, const double *a, const double *b, size_t size);
+void Mul(double *out, const double *a, double b, size_t size);
+// out = a + (b - a) * t
+void Mix(double *out, const double *a, const double *b, double t,
+         size_t size);
+
+enum class Window { Hann, Hamming, Blackman };
+void ApplyWindow(double *a, size_t size, Window window);
+
+// size has to be a power of two, re and im get size / 2 + 1 bins
+bool RealFFT(const double *in, size_t size, double *re, double *im);
+bool Spectrum(const double *in, size_t size, double *magnitudes);
+
+JSModuleDef *CreateModule(JSContext *ctx, const char *name);
+} // namespace VQJS::DSP
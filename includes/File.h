@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <optional>
@@ -13,4 +15,20 @@ struct File {
   static std::string GetName(const std::string & file);
   static bool CreateDirectory(const std::string& file);
 };
+
+// Read only mapping of a whole file, unmapped on destruction
+struct MappedFile {
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+
+  bool Open(const std::string &file);
+  void Close();
+  [[nodiscard]] const uint8_t *Data() const { return m_Data; }
+  [[nodiscard]] size_t Size() const { return m_Size; }
+
+private:
+  const uint8_t *m_Data{nullptr};
+  size_t m_Size{0};
+};
 } // namespace VQJS
@@ -0,0 +1,22 @@
+#pragma once
+#include "vqjs.h"
+
+#include <string>
+#include <string_view>
+
+namespace VQJS {
+
+// Native JSON, exposed to scripts as vqjs.json.parse/stringify.
+// parse accepts a string, ArrayBuffer or Uint8Array and builds the values
+// directly in the engine, stringify writes into a reusable native buffer.
+struct Json {
+  // Returns an exception value (SyntaxError) on invalid input
+  [[nodiscard]] static Value Parse(const Value &ctx, std::string_view json);
+  // Appends to out, false if the value can't be serialized (cycles,
+  // BigInt, throwing toJSON). The exception is left on the Context then.
+  static bool Stringify(const Value &value, std::string &out);
+
+  // Adds the json object to target
+  static void Install(const Value &target);
+};
+} // namespace VQJS
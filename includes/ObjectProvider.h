@@ -0,0 +1,30 @@
+#pragma once
+#include "vqjs.h"
+
+#include <string>
+#include <vector>
+
+namespace VQJS {
+
+// Backs a JS object with native data. Nothing is copied up front, every
+// property access from JS ends up in Get/Set, so large trees only cost
+// what a script actually touches. Children can be providers as well.
+struct ObjectProvider {
+  virtual ~ObjectProvider() = default;
+
+  // Set out and return true if the key exists. Use self to create values
+  // (self.Number(...), ObjectProvider::New(self, child), ...)
+  virtual bool Get(const Value &self, const std::string &key, Value &out) = 0;
+  [[nodiscard]] virtual std::vector<std::string> Keys() = 0;
+  // Returning false stores the value as a plain JS property on the object
+  virtual bool Set([[maybe_unused]] const Value &self,
+                   [[maybe_unused]] const std::string &key,
+                   [[maybe_unused]] const Value &value) {
+    return false;
+  }
+
+  static Value New(Instance &instance, const Ref<ObjectProvider> &provider);
+  // Creates the object in the Context of ctx
+  static Value New(const Value &ctx, const Ref<ObjectProvider> &provider);
+};
+} // namespace VQJS
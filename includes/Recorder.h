@@ -0,0 +1,76 @@
+#pragma once
+#include "vqjs.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VQJS {
+
+// Log of what the host feeds into the scripts of an Instance, see
+// Instance::SetRecorder:
+//  - Value::Call / CallBind from C++, not the ones made inside callbacks.
+//    Only the name of the function is kept, so vqjs-replay can repeat
+//    calls of global functions but not of methods or closures.
+//  - results of native functions added to the global object while recording
+//  - frames, Instance::BeginFrame or Frame
+// vqjs-replay runs the scripts against it again (src/vqjs-replay.cpp).
+// Arguments and results are structured clones, each argument on its own.
+// SharedArrayBuffers and typed arrays on them are recorded as copies in
+// plain ArrayBuffers. Values that can't be cloned (functions, shared
+// buffers inside objects) end up as undefined, the other arguments are
+// kept. Natives that threw are recorded with their exception.
+struct Recorder {
+  static constexpr uint32_t Magic = 0x524a5156; // VQJR
+  static constexpr uint32_t Version = 2;
+
+  // Throw is a Result of a native that threw
+  enum class Kind : uint8_t { Frame, Native, Call, Result, Throw };
+  struct Event {
+    Kind Type{Kind::Frame};
+    // since the Recorder got created
+    std::chrono::nanoseconds Time{0};
+    // native or called function
+    std::string Name{};
+    // result, exception or the arguments (see DecodeArgs)
+    std::vector<uint8_t> Data{};
+  };
+
+  explicit Recorder(const std::string &file);
+  ~Recorder();
+  Recorder(const Recorder &) = delete;
+  [[nodiscard]] bool IsOpen() const;
+
+  void Frame();
+  void Native(std::string_view name);
+  void Call(const Value &function, const std::vector<Value> &args);
+  void Result(std::string_view name, const Value &result);
+  void Flush();
+
+  [[nodiscard]] static bool Read(const std::string &file,
+                                 std::vector<Event> &out);
+  // undefined for empty data
+  [[nodiscard]] static Value Decode(const Value &ctx,
+                                    const std::vector<uint8_t> &data);
+  // Arguments of a Call event
+  [[nodiscard]] static std::vector<Value>
+  DecodeArgs(const Value &ctx, const std::vector<uint8_t> &data);
+  // What the native returned while recording, a Throw event is thrown again
+  [[nodiscard]] static Value Replay(const Value &ctx, const Event &event);
+
+private:
+  void Write(Kind type, std::string_view name, const uint8_t *data = nullptr,
+             size_t size = 0);
+  void Write(Kind type, std::string_view name, const Value &value);
+
+  std::ofstream m_File;
+  std::vector<uint8_t> m_Buffer{};
+  std::chrono::steady_clock::time_point m_Start;
+  // > 0 while a native function runs
+  size_t m_Depth{0};
+  friend ValueUtils;
+};
+} // namespace VQJS
@@ -0,0 +1,248 @@
+#pragma once
+#include "vqjs.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Describes the fields of a struct for ToJS/FromJS, has to be used in the
+// global namespace:
+//   struct Event { int id; std::string name; std::optional<Vec3> pos; };
+//   VQJS_REFLECT(Event, id, name, pos)
+#define VQJS_REFLECT(Type, ...)                                                \
+  template <> struct VQJS::Reflect<Type> {                                     \
+    static constexpr const char *Names[] = {                                   \
+        VQJS_FOR_EACH(VQJS_REFLECT_NAME, Type, __VA_ARGS__)};                  \
+    static constexpr auto Members = std::make_tuple(                           \
+        VQJS_FOR_EACH(VQJS_REFLECT_MEMBER, Type, __VA_ARGS__));                \
+  };
+
+#define VQJS_REFLECT_NAME(Type, member) #member
+#define VQJS_REFLECT_MEMBER(Type, member) &Type::member
+
+// up to 64 fields
+#define VQJS_PARENS ()
+#define VQJS_EXPAND(...)                                                       \
+  VQJS_EXPAND3(VQJS_EXPAND3(VQJS_EXPAND3(VQJS_EXPAND3(__VA_ARGS__))))
+#define VQJS_EXPAND3(...)                                                      \
+  VQJS_EXPAND2(VQJS_EXPAND2(VQJS_EXPAND2(VQJS_EXPAND2(__VA_ARGS__))))
+#define VQJS_EXPAND2(...)                                                      \
+  VQJS_EXPAND1(VQJS_EXPAND1(VQJS_EXPAND1(VQJS_EXPAND1(__VA_ARGS__))))
+#define VQJS_EXPAND1(...) __VA_ARGS__
+#define VQJS_FOR_EACH(macro, type, ...)                                        \
+  __VA_OPT__(VQJS_EXPAND(VQJS_FOR_EACH_HELPER(macro, type, __VA_ARGS__)))
+#define VQJS_FOR_EACH_HELPER(macro, type, a1, ...)                             \
+  macro(type, a1) __VA_OPT__(                                                  \
+      , VQJS_FOR_EACH_AGAIN VQJS_PARENS(macro, type, __VA_ARGS__))
+#define VQJS_FOR_EACH_AGAIN() VQJS_FOR_EACH_HELPER
+
+namespace VQJS {
+
+template <typename T> struct Reflect;
+
+// Engine side of the converters. Atoms are interned once per Context and
+// type, objects are always built in field order so they end up sharing
+// one shape and the property inline caches in scripts keep hitting.
+struct Reflection {
+  static const uint32_t *Atoms(const Value &ctx, const void *type,
+                               const char *const *names, size_t count);
+  [[nodiscard]] static Value Get(const Value &obj, uint32_t atom);
+  static void Define(const Value &obj, uint32_t atom, const Value &value);
+
+  [[nodiscard]] static Value Int(const Value &ctx, int64_t value);
+  [[nodiscard]] static Value GetIndex(const Value &array, uint32_t index);
+  static void SetIndex(const Value &array, uint32_t index, const Value &value);
+  [[nodiscard]] static uint32_t Length(const Value &array);
+  [[nodiscard]] static bool IsNullish(const Value &value);
+};
+
+template <typename T, typename = void> struct Converter;
+
+template <typename T, typename = void> struct IsReflected : std::false_type {};
+template <typename T>
+struct IsReflected<T, std::void_t<decltype(Reflect<T>::Members)>>
+    : std::true_type {};
+
+template <> struct Converter<Value> {
+  static Value To(const Value &, const Value &value) { return value; }
+  static bool From(const Value &value, Value &out) {
+    out = value;
+    return true;
+  }
+};
+
+template <> struct Converter<bool> {
+  static Value To(const Value &ctx, const bool value) {
+    return ctx.Boolean(value);
+  }
+  static bool From(const Value &value, bool &out) {
+    if (!value.IsBoolean())
+      return false;
+    out = value.AsBool();
+    return true;
+  }
+};
+
+template <> struct Converter<std::string> {
+  static Value To(const Value &ctx, const std::string &value) {
+    return ctx.String(value);
+  }
+  static bool From(const Value &value, std::string &out) {
+    if (!value.IsString())
+      return false;
+    out = value.AsString();
+    return true;
+  }
+};
+
+template <typename T>
+struct Converter<T, std::enable_if_t<std::is_integral_v<T>>> {
+  static Value To(const Value &ctx, const T value) {
+    return Reflection::Int(ctx, static_cast<int64_t>(value));
+  }
+  static bool From(const Value &value, T &out) {
+    if (!value.IsNumber())
+      return false;
+    out = static_cast<T>(value.AsInt());
+    return true;
+  }
+};
+
+template <typename T>
+struct Converter<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static Value To(const Value &ctx, const T value) {
+    return ctx.Number(static_cast<double>(value));
+  }
+  static bool From(const Value &value, T &out) {
+    if (!value.IsNumber())
+      return false;
+    out = static_cast<T>(value.AsDouble());
+    return true;
+  }
+};
+
+template <typename T> struct Converter<T, std::enable_if_t<std::is_enum_v<T>>> {
+  typedef std::underlying_type_t<T> Underlying;
+  static Value To(const Value &ctx, const T value) {
+    return Converter<Underlying>::To(ctx, static_cast<Underlying>(value));
+  }
+  static bool From(const Value &value, T &out) {
+    Underlying raw{};
+    if (!Converter<Underlying>::From(value, raw))
+      return false;
+    out = static_cast<T>(raw);
+    return true;
+  }
+};
+
+template <typename T> struct Converter<std::optional<T>> {
+  static Value To(const Value &ctx, const std::optional<T> &value) {
+    return value ? Converter<T>::To(ctx, *value) : ctx.Undefined();
+  }
+  static bool From(const Value &value, std::optional<T> &out) {
+    if (Reflection::IsNullish(value)) {
+      out.reset();
+      return true;
+    }
+    T data{};
+    if (!Converter<T>::From(value, data))
+      return false;
+    out = std::move(data);
+    return true;
+  }
+};
+
+template <typename T> struct Converter<std::vector<T>> {
+  static Value To(const Value &ctx, const std::vector<T> &value) {
+    Value array = ctx.NewArray();
+    for (size_t i = 0; i < value.size(); i++) {
+      Reflection::SetIndex(array, static_cast<uint32_t>(i),
+                           Converter<T>::To(ctx, value[i]));
+    }
+    return array;
+  }
+  static bool From(const Value &value, std::vector<T> &out) {
+    if (!value.IsArray())
+      return false;
+    const uint32_t size = Reflection::Length(value);
+    out.clear();
+    out.reserve(size);
+    for (uint32_t i = 0; i < size; i++) {
+      T data{};
+      if (!Converter<T>::From(Reflection::GetIndex(value, i), data))
+        return false;
+      out.push_back(std::move(data));
+    }
+    return true;
+  }
+};
+
+template <typename T>
+struct Converter<T, std::enable_if_t<IsReflected<T>::value>> {
+  static constexpr size_t Count = std::size(Reflect<T>::Names);
+
+  static const uint32_t *Atoms(const Value &ctx) {
+    return Reflection::Atoms(ctx, &Reflect<T>::Names, Reflect<T>::Names,
+                             Count);
+  }
+
+  static Value To(const Value &ctx, const T &value) {
+    const uint32_t *atoms = Atoms(ctx);
+    Value obj = ctx.Object();
+    size_t i = 0;
+    std::apply(
+        [&](const auto... member) {
+          ((Reflection::Define(
+               obj, atoms[i++],
+               Converter<std::decay_t<decltype(value.*member)>>::To(
+                   ctx, value.*member))),
+           ...);
+        },
+        Reflect<T>::Members);
+    return obj;
+  }
+
+  // Missing fields keep their current value
+  static bool From(const Value &value, T &out) {
+    if (!value.IsObject())
+      return false;
+    const uint32_t *atoms = Atoms(value);
+    size_t i = 0;
+    bool ok = true;
+    std::apply(
+        [&](const auto... member) {
+          ((ok = ok && Read(Reflection::Get(value, atoms[i++]), out.*member)),
+           ...);
+        },
+        Reflect<T>::Members);
+    return ok;
+  }
+
+private:
+  template <typename F> static bool Read(const Value &field, F &out) {
+    if (Reflection::IsNullish(field))
+      return true;
+    return Converter<F>::From(field, out);
+  }
+};
+
+// ctx is only used to pick the Context, any value of it works
+template <typename T> Value ToJS(const Value &ctx, const T &value) {
+  return Converter<T>::To(ctx, value);
+}
+template <typename T> Value ToJS(Instance &instance, const T &value) {
+  return Converter<T>::To(instance.Undefined(), value);
+}
+// false if the value doesn't match, out may be partially filled then
+template <typename T> bool FromJS(const Value &value, T &out) {
+  return Converter<T>::From(value, out);
+}
+template <typename T> T FromJS(const Value &value) {
+  T out{};
+  Converter<T>::From(value, out);
+  return out;
+}
+} // namespace VQJS
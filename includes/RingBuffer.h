@@ -0,0 +1,163 @@
+#pragma once
+#include "BufferPool.h"
+#include "vqjs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace VQJS {
+
+// Kept apart from the samples, the buffer handed to scripts can't move the
+// indices. Indices are free running and wrap naturally.
+struct RingBufferHeader {
+  alignas(64) std::atomic<uint32_t> Write{0};
+  alignas(64) std::atomic<uint32_t> Read{0};
+  alignas(64) std::atomic<uint32_t> Overruns{0};
+  uint32_t Capacity{0};
+  uint32_t Channels{0};
+  uint32_t ElementSize{0};
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+// Single producer (native thread), single consumer (script thread).
+// Channels share the indices, so a frame is always written and read for all
+// channels at once.
+template <typename T> struct RingBuffer {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  explicit RingBuffer(const size_t frames, const size_t channels = 1)
+      : m_Capacity(std::bit_ceil(std::max<size_t>(frames, 1))),
+        m_Channels(std::max<size_t>(channels, 1)),
+        m_Header(std::make_unique<RingBufferHeader>()) {
+    m_Bytes = m_Capacity * m_Channels * sizeof(T);
+    m_Memory = BufferPool::Get().Allocate(m_Bytes, true);
+    m_Header->Capacity = static_cast<uint32_t>(m_Capacity);
+    m_Header->Channels = static_cast<uint32_t>(m_Channels);
+    m_Header->ElementSize = sizeof(T);
+  }
+  ~RingBuffer() { BufferPool::Get().Release(m_Memory); }
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  // Producer, wait-free. Frames that don't fit are dropped and counted as
+  // overruns. Returns the written frames.
+  size_t Write(const T *const *channels, const size_t frames) {
+    const uint32_t write = m_Header->Write.load(std::memory_order_relaxed);
+    const uint32_t read = m_Header->Read.load(std::memory_order_acquire);
+    const size_t count = std::min(frames, m_Capacity - (write - read));
+    if (count < frames) {
+      m_Header->Overruns.fetch_add(static_cast<uint32_t>(frames - count),
+                                   std::memory_order_relaxed);
+    }
+    for (size_t c = 0; c < m_Channels; c++) {
+      Copy(Channel(c), write, channels[c], count);
+    }
+    m_Header->Write.store(write + static_cast<uint32_t>(count),
+                          std::memory_order_release);
+    return count;
+  }
+  size_t Write(const T *data, const size_t frames) {
+    assert(m_Channels == 1);
+    return Write(&data, frames);
+  }
+
+  // Consumer. Channels that are nullptr get skipped, but are consumed anyway
+  size_t Read(T *const *channels, const size_t channelCount,
+              const size_t frames) {
+    const uint32_t read = m_Header->Read.load(std::memory_order_relaxed);
+    const uint32_t write = m_Header->Write.load(std::memory_order_acquire);
+    const size_t count = std::min<size_t>(frames, write - read);
+    for (size_t c = 0; c < std::min(channelCount, m_Channels); c++) {
+      if (channels[c])
+        Copy(channels[c], Channel(c), read, count);
+    }
+    m_Header->Read.store(read + static_cast<uint32_t>(count),
+                         std::memory_order_release);
+    return count;
+  }
+
+  [[nodiscard]] size_t Available() const {
+    return m_Header->Write.load(std::memory_order_acquire) -
+           m_Header->Read.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] size_t Space() const { return m_Capacity - Available(); }
+  [[nodiscard]] uint32_t Overruns() const {
+    return m_Header->Overruns.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] size_t Capacity() const { return m_Capacity; }
+  [[nodiscard]] size_t Channels() const { return m_Channels; }
+
+  // JS side: { buffer, channels, capacity, read(...targets), available(),
+  // overruns() }. buffer only holds the samples, channel after channel.
+  // read copies straight into the given typed arrays, one per channel, and
+  // returns the frames read.
+  static Value Bind(const Ref<RingBuffer> &ring, const Value &context) {
+    auto object = context.Object();
+    object.Set("buffer",
+               context.PooledSharedArrayBuffer(ring->m_Memory, ring->m_Bytes));
+    object.Set("channels",
+               context.Number(static_cast<double>(ring->m_Channels)));
+    object.Set("capacity",
+               context.Number(static_cast<double>(ring->m_Capacity)));
+    object.AddFunction(
+        "read",
+        [ring](const Value &_, const std::vector<Value> &args) {
+          if (args.empty() || args.size() > ring->m_Channels)
+            return _.ThrowException("Argument count mismatch");
+          std::vector<T *> targets(args.size(), nullptr);
+          size_t frames = ring->m_Capacity;
+          for (size_t i = 0; i < args.size(); i++) {
+            if (!args[i].IsTypedArray<T>())
+              return _.ThrowException("Argument type mismatch.");
+            const auto target = args[i].AsTypedArray<T>();
+            targets[i] = target.Data;
+            frames = std::min(frames, target.Size);
+          }
+          const size_t read =
+              ring->Read(targets.data(), targets.size(), frames);
+          return _.Number(static_cast<double>(read));
+        },
+        1);
+    object.AddFunction(
+        "available", [ring](const Value &_, const std::vector<Value> &) {
+          return _.Number(static_cast<double>(ring->Available()));
+        });
+    object.AddFunction(
+        "overruns", [ring](const Value &_, const std::vector<Value> &) {
+          return _.Number(static_cast<double>(ring->Overruns()));
+        });
+    return object;
+  }
+
+private:
+  T *Channel(const size_t channel) const {
+    return reinterpret_cast<T *>(m_Memory) + channel * m_Capacity;
+  }
+
+  void Copy(T *ring, const uint32_t index, const T *from,
+            const size_t count) const {
+    const size_t start = index & (m_Capacity - 1);
+    const size_t first = std::min(count, m_Capacity - start);
+    std::memcpy(ring + start, from, first * sizeof(T));
+    std::memcpy(ring, from + first, (count - first) * sizeof(T));
+  }
+
+  void Copy(T *to, const T *ring, const uint32_t index,
+            const size_t count) const {
+    const size_t start = index & (m_Capacity - 1);
+    const size_t first = std::min(count, m_Capacity - start);
+    std::memcpy(to, ring + start, first * sizeof(T));
+    std::memcpy(to + first, ring, (count - first) * sizeof(T));
+  }
+
+  size_t m_Capacity;
+  size_t m_Channels;
+  size_t m_Bytes{0};
+  uint8_t *m_Memory{nullptr};
+  std::unique_ptr<RingBufferHeader> m_Header;
+};
+} // namespace VQJS
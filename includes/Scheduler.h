@@ -0,0 +1,89 @@
+#pragma once
+#include "vqjs.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace VQJS {
+
+// Runs Instance tasks on a pool of threads. Every runtime gets a strand, its
+// tasks run in order and never on two threads at once (instances from
+// Runtime::CreateInstance share one). Strands belong to the instance that
+// created the runtime, so they stay the same across Reset. Threads pick
+// strands from their own queue first and steal from the others when it is
+// empty.
+// Tasks keep their instance alive. If the poster lets go of it first, the
+// instance is destroyed on a pool thread, still inside its strand. A
+// private heap is then left to its creating thread, see Context.
+struct Scheduler {
+  typedef std::function<void(Instance &)> Task;
+  typedef std::chrono::steady_clock Clock;
+
+  struct FrameResult {
+    size_t Completed{0};
+    // started after the deadline, not run at all
+    size_t Skipped{0};
+    // threw, also counted by FailedCount
+    size_t Failed{0};
+    bool Late{false};
+  };
+
+  // 0 == one thread per core
+  explicit Scheduler(size_t threads = 0);
+  ~Scheduler();
+  Scheduler(const Scheduler &) = delete;
+
+  void Post(const Ref<Instance> &instance, Task task);
+  // Runs task once for every instance and waits for all of them. Tasks
+  // that would start after the deadline are skipped. From inside a task it
+  // would wait on its own thread, so nothing runs and all are skipped.
+  FrameResult Frame(const std::vector<Ref<Instance>> &instances,
+                    const Task &task, Clock::time_point deadline);
+  // Blocks until every posted task is done
+  void Wait();
+
+  [[nodiscard]] size_t ThreadCount() const { return m_Threads.size(); }
+  // Tasks that threw. The exception is dropped, the strand goes on.
+  [[nodiscard]] size_t FailedCount() const { return m_Failed.load(); }
+
+private:
+  struct Strand {
+    const Instance *Owner{nullptr};
+    std::mutex Mutex;
+    std::deque<std::pair<Ref<Instance>, Task>> Tasks;
+    bool Queued{false};
+  };
+  struct Queue {
+    std::mutex Mutex;
+    std::deque<Ref<Strand>> Strands;
+  };
+
+  void Loop(size_t index);
+  void Schedule(const Ref<Strand> &strand);
+  [[nodiscard]] Ref<Strand> Next(size_t index);
+  void Run(const Ref<Strand> &strand);
+
+  std::vector<std::unique_ptr<Queue>> m_Queues{};
+  std::mutex m_StrandMutex{};
+  // by Instance::m_Owner, the JSRuntime changes on Reset
+  std::unordered_map<const Instance *, Ref<Strand>> m_Strands{};
+
+  std::mutex m_Mutex{};
+  std::condition_variable m_Wake{};
+  std::condition_variable m_Idle{};
+  size_t m_Ready{0};
+  size_t m_Pending{0};
+  bool m_Stop{false};
+  std::atomic<size_t> m_Next{0};
+  std::atomic<size_t> m_Failed{0};
+  std::vector<std::thread> m_Threads{};
+};
+} // namespace VQJS
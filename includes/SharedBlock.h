@@ -0,0 +1,186 @@
+#pragma once
+#include "BufferPool.h"
+#include "Reflect.h"
+#include "vqjs.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace VQJS {
+
+// Field offsets of a VQJS_REFLECT struct and the generated JS accessor.
+// Supported fields: float, double, bool, integers up to 32 bit, enums of
+// those and one dimensional arrays of them.
+struct SharedLayout {
+  struct Field {
+    const char *Name;
+    // typed array used for it
+    const char *View;
+    uint32_t Offset;
+    uint32_t ElementSize;
+    // 0 for plain fields
+    uint32_t Count;
+    bool Bool;
+  };
+  // BufferedBlock state in front of the copies
+  static constexpr size_t HeaderSize = BufferPool::Alignment;
+  static constexpr uint32_t Dirty = 4;
+  static constexpr uint32_t IndexMask = 3;
+
+  template <typename T> static const std::vector<Field> &Of() {
+    static_assert(std::is_trivially_copyable_v<T> &&
+                      std::is_standard_layout_v<T>,
+                  "SharedBlock types have to be plain structs");
+    static const std::vector<Field> fields = [] {
+      static const T sample{};
+      std::vector<Field> out;
+      size_t i = 0;
+      std::apply(
+          [&](const auto... member) {
+            (out.push_back(Describe(Reflect<T>::Names[i++], sample, member)),
+             ...);
+          },
+          Reflect<T>::Members);
+      return out;
+    }();
+    return fields;
+  }
+
+  // Builds the accessor object on buffer. stride == 0 is a single block,
+  // otherwise the three copies of a BufferedBlock.
+  [[nodiscard]] static Value Bind(const Value &context, const Value &buffer,
+                                  const std::vector<Field> &fields,
+                                  size_t stride = 0);
+  [[nodiscard]] static std::string Source(const std::vector<Field> &fields,
+                                          size_t stride);
+
+private:
+  template <typename E> static constexpr const char *View() {
+    if constexpr (std::is_enum_v<E>)
+      return View<std::underlying_type_t<E>>();
+    else if constexpr (std::is_same_v<E, bool>)
+      return "Uint8Array";
+    else if constexpr (std::is_same_v<E, float>)
+      return "Float32Array";
+    else if constexpr (std::is_same_v<E, double>)
+      return "Float64Array";
+    else if constexpr (std::is_integral_v<E> && sizeof(E) == 1)
+      return std::is_signed_v<E> ? "Int8Array" : "Uint8Array";
+    else if constexpr (std::is_integral_v<E> && sizeof(E) == 2)
+      return std::is_signed_v<E> ? "Int16Array" : "Uint16Array";
+    else if constexpr (std::is_integral_v<E> && sizeof(E) == 4)
+      return std::is_signed_v<E> ? "Int32Array" : "Uint32Array";
+    else
+      static_assert(sizeof(E) == 0, "Field type can't be shared");
+  }
+
+  template <typename T, typename M>
+  static Field Describe(const char *name, const T &sample, M T::*member) {
+    static_assert(std::rank_v<M> <= 1, "Only 1D arrays can be shared");
+    typedef std::remove_all_extents_t<M> E;
+    const auto offset = reinterpret_cast<const uint8_t *>(&(sample.*member)) -
+                        reinterpret_cast<const uint8_t *>(&sample);
+    return {name,
+            View<E>(),
+            static_cast<uint32_t>(offset),
+            sizeof(E),
+            static_cast<uint32_t>(std::extent_v<M>),
+            std::is_same_v<E, bool>};
+  }
+};
+
+// Plain struct shared with scripts, fields come from VQJS_REFLECT:
+//   struct Params { float gain; int32_t mode; bool mute; float eq[8]; };
+//   VQJS_REFLECT(Params, gain, mode, mute, eq)
+//   auto params = CreateRef<SharedBlock<Params>>();
+//   global.Set("params", SharedBlock<Params>::Bind(params, global));
+//   params->Data().gain = 0.5f;
+// Scripts read and write params.gain directly in the memory, arrays are
+// typed array views. No calls into C++ and no copies, but also no
+// synchronization, see BufferedBlock for that.
+template <typename T> struct SharedBlock {
+  // typed array views need a multiple of their element size
+  static constexpr size_t Bytes =
+      (sizeof(T) + BufferPool::Alignment - 1) & ~(BufferPool::Alignment - 1);
+
+  SharedBlock() {
+    m_Memory = BufferPool::Get().Allocate(Bytes, true);
+    m_Data = new (m_Memory) T{};
+  }
+  ~SharedBlock() { BufferPool::Get().Release(m_Memory); }
+  SharedBlock(const SharedBlock &) = delete;
+  SharedBlock &operator=(const SharedBlock &) = delete;
+
+  T &Data() { return *m_Data; }
+  const T &Data() const { return *m_Data; }
+
+  // the buffer keeps the memory alive, block can go away before it
+  static Value Bind(const Ref<SharedBlock> &block, const Value &context) {
+    return SharedLayout::Bind(
+        context, context.PooledSharedArrayBuffer(block->m_Memory, Bytes),
+        SharedLayout::Of<T>());
+  }
+
+private:
+  uint8_t *m_Memory{nullptr};
+  T *m_Data{nullptr};
+};
+
+// Tear-free variant for native -> script updates. There are three copies,
+// so neither side ever waits or sees a half written block:
+//   params->Back().gain = 0.5f;
+//   params->Publish();
+//   // script, once per frame
+//   if (params.update()) applyGain(params.gain);
+// update() takes the latest published copy and returns false if there is
+// none. The fields are read only for scripts.
+template <typename T> struct BufferedBlock {
+  static constexpr size_t Stride =
+      (sizeof(T) + BufferPool::Alignment - 1) & ~(BufferPool::Alignment - 1);
+  static constexpr size_t Bytes = SharedLayout::HeaderSize + 3 * Stride;
+
+  BufferedBlock() {
+    m_Memory = BufferPool::Get().Allocate(Bytes, true);
+    // script reads 0, 1 is ready for it, native writes 2
+    m_State = new (m_Memory) std::atomic<uint32_t>(1);
+    for (uint32_t i = 0; i < 3; i++)
+      new (Copy(i)) T{};
+  }
+  ~BufferedBlock() { BufferPool::Get().Release(m_Memory); }
+  BufferedBlock(const BufferedBlock &) = delete;
+  BufferedBlock &operator=(const BufferedBlock &) = delete;
+
+  // Always starts with the last published values
+  T &Back() { return *Copy(m_Back); }
+  void Publish() {
+    const uint32_t published = m_Back;
+    m_Back = m_State->exchange(published | SharedLayout::Dirty,
+                               std::memory_order_acq_rel) &
+             SharedLayout::IndexMask;
+    std::memcpy(Copy(m_Back), Copy(published), sizeof(T));
+  }
+
+  static Value Bind(const Ref<BufferedBlock> &block, const Value &context) {
+    return SharedLayout::Bind(
+        context, context.PooledSharedArrayBuffer(block->m_Memory, Bytes),
+        SharedLayout::Of<T>(), Stride);
+  }
+
+private:
+  T *Copy(const uint32_t index) const {
+    return reinterpret_cast<T *>(m_Memory + SharedLayout::HeaderSize +
+                                 index * Stride);
+  }
+
+  uint8_t *m_Memory{nullptr};
+  std::atomic<uint32_t> *m_State{nullptr};
+  uint32_t m_Back{2};
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+} // namespace VQJS
@@ -0,0 +1,80 @@
+#pragma once
+#include "vqjs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VQJS {
+
+// Structured clone of a value. SharedArrayBuffers are only referenced, the
+// message holds a BufferPool reference on them, everything else is copied.
+struct Message {
+  Message() = default;
+  Message(Message &&other) noexcept;
+  Message &operator=(Message &&other) noexcept;
+  Message(const Message &) = delete;
+  ~Message();
+
+  // ArrayBuffers listed in transfer are detached after writing. Returns
+  // the exception if value can't be cloned.
+  [[nodiscard]] static Value Write(const Value &value, const Value &transfer,
+                                   Message &out);
+  [[nodiscard]] Value Read(const Value &ctx) const;
+
+private:
+  std::vector<uint8_t> m_Data{};
+  std::vector<uint8_t *> m_Shared{};
+};
+
+// Module running in its own Instance (and runtime) on a native thread,
+// scripts use it like a web worker:
+//   const worker = new Worker("@/analysis.ts");
+//   worker.onmessage = (e) => draw(e.data);
+//   worker.postMessage({spectrum}, [buffer]);
+// The worker itself gets the global onmessage, postMessage and close.
+// SharedArrayBuffers are shared between both sides and work with Atomics,
+// only the worker may block in Atomics.wait. Buffers created by scripts come
+// from the BufferPool and stay alive as long as one side uses them.
+struct Worker {
+  Worker(Runtime &runtime, std::string file, std::string baseDirectory);
+  ~Worker();
+  Worker(const Worker &) = delete;
+
+  void Post(Message message);
+  // Waits for the thread, a worker blocked in Atomics.wait has to be woken
+  // up first
+  void Terminate();
+  [[nodiscard]] bool IsRunning() const;
+
+  // Adds the Worker constructor
+  static void Install(Instance &instance);
+
+private:
+  void Run();
+  void Join();
+  // host side, returns the delivered messages
+  size_t Dispatch();
+  static Value Constructor(Instance &instance);
+
+  Runtime &m_Runtime;
+  std::string m_File;
+  std::string m_BaseDirectory;
+  // copied on the creating thread
+  Runtime::Config m_Config;
+  std::mutex m_Mutex{};
+  std::condition_variable m_Wake{};
+  std::deque<Message> m_Inbox{};
+  std::deque<Message> m_Outbox{};
+  std::atomic<bool> m_Running{true};
+  Value m_OnMessage{};
+  std::thread m_Thread{};
+
+  friend Instance;
+};
+} // namespace VQJS
@@ -1,12 +1,23 @@
 #pragma once
 #include <string>
+#include <string_view>
 namespace VQJS {
 
 struct Logger {
+  enum class Level { Debug = 0, Info, Warn, Error };
+
   virtual ~Logger() = default;
-  virtual void Info(const std::string &) const;
-  virtual void Debug(const std::string &) const;
-  virtual void Error(const std::string &) const;
-  virtual void Warn(const std::string &) const;
+  virtual void Info(const std::string &);
+  virtual void Debug(const std::string &);
+  virtual void Error(const std::string &);
+  virtual void Warn(const std::string &);
+  // Used by console.*, forwards to the methods above by default
+  virtual void Log(Level level, std::string_view line);
+
+  // console.* checks this before converting anything
+  [[nodiscard]] bool Enabled(const Level level) const {
+    return level >= MinLevel;
+  }
+  Level MinLevel{Level::Debug};
 };
 } // namespace VQJS
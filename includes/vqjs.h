@@ -2,16 +2,25 @@
 #include "internals.h"
 #include "vqjs-modules.h"
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <future>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 // QuickJS classes
 struct JSRuntime;
 struct JSContext;
 struct JSValue;
+struct JSModuleDef;
 
 namespace VQJS {
 
@@ -28,12 +37,91 @@ struct RuntimeInitFailedException final : std::exception {
 };
 
 struct ValueUtils;
+struct ClassBindingUtils;
+struct ObjectProviderUtils;
+struct Reflection;
+struct Json;
+struct Script;
+struct Message;
+struct Worker;
+struct Recorder;
+struct CommandBuffer;
+struct Scheduler;
 struct Runtime;
 struct Instance;
+struct ContextHeap;
+struct Bundle;
+struct BundleWriter;
+
+// Allocations of one JSRuntime, shared by all Contexts living on it
+struct HeapStats {
+  size_t LiveBytes{0};
+  size_t PeakBytes{0};
+  size_t LiveAllocations{0};
+  size_t TotalAllocations{0};
+};
+
+// Snapshot of JS_ComputeMemoryUsage, sizes are in bytes
+struct MemoryStats {
+  struct Usage {
+    int64_t Count{0};
+    int64_t Size{0};
+  };
+  // -1 == no limit
+  int64_t Limit{-1};
+  Usage Malloc;
+  Usage Used;
+  Usage Atoms;
+  Usage Strings;
+  Usage Objects;
+  Usage Properties;
+  Usage Shapes;
+  Usage Functions;
+  int64_t Bytecode{0};
+  int64_t CFunctions{0};
+  int64_t Arrays{0};
+  int64_t FastArrays{0};
+  int64_t FastArrayElements{0};
+  Usage ArrayBuffers;
+  HeapStats Heap;
+};
+
+// One collection done by Instance::Idle, sizes are live heap bytes
+struct GCEvent {
+  std::chrono::nanoseconds Pause{0};
+  size_t Before{0};
+  size_t After{0};
+};
+
+// Counters of the compiled script cache, see Instance::Compile
+struct ScriptCacheStats {
+  size_t Hits{0};
+  size_t Misses{0};
+  // dropped as least recently used
+  size_t Evictions{0};
+  size_t Size{0};
+};
+
+struct GCPolicy {
+  // automatic GC threshold between BeginFrame and EndFrame, 0 == disabled
+  size_t FrameThreshold{0};
+  // Idle skips collecting if less got allocated since the last one
+  size_t MinGrowth{64 * 1024};
+  // pause estimate until Idle measured its first collection, on the safe
+  // side for a heap full of small objects
+  double InitialNsPerByte{2.0};
+  std::function<void(Instance &, const GCEvent &)> OnCollect{};
+};
 
 struct Context {
   Context();
-  explicit Context(Instance *);
+  // privateHeap gives the runtime its own mimalloc heap, owned by the
+  // creating thread. The Context has to be released before it exits. If
+  // that happens on another thread, the owner destroys the heap the next
+  // time it creates or frees a runtime, or when it exits.
+  explicit Context(Instance *, bool privateHeap = true);
+  // New JSContext on the JSRuntime of other, they share atoms and the GC
+  Context(Instance *, const Context &other);
   ~Context();
   Context(const Context &);
   Context(Context &&) = delete;
@@ -41,17 +129,54 @@ struct Context {
   operator JSRuntime *() const { return Rt; }
   Context &operator=(const Context &other) noexcept;
   Context &operator=(Context &&other) noexcept = delete;
-  static void PrintStats();
+  // Dumps the engine memory usage to stdout
+  void PrintStats() const;
+  [[nodiscard]] HeapStats GetHeapStats() const;
+  // Walks the whole runtime, not for hot paths
+  [[nodiscard]] MemoryStats GetMemoryStats() const;
+  // JSClassIDs belong to the runtime, so every Context on it shares them
+  // (the prototypes don't). 0 if key has none yet, owner is kept alive
+  // together with the runtime.
+  [[nodiscard]] uint32_t GetClassID(const void *key) const;
+  void SetClassID(const void *key, uint32_t id, Ref<void> owner) const;
 
   operator bool() const { return Ctx != nullptr && Rt != nullptr; }
 
 private:
   JSRuntime *Rt;
   JSContext *Ctx;
-  int *Count;
+  std::atomic<int> *Count;
+  // number of Contexts (not copies) living on Rt
+  std::atomic<int> *RtCount;
+  ContextHeap *Heap;
   void Release() const;
 };
 
+// UTF-8 view into a JS string without copying it. ASCII strings are handed
+// out by the engine directly, numbers and booleans are formatted inline.
+struct BorrowedString {
+  BorrowedString() = default;
+  ~BorrowedString();
+  BorrowedString(const BorrowedString &) = delete;
+  BorrowedString(BorrowedString &&other) noexcept;
+  BorrowedString &operator=(const BorrowedString &) = delete;
+
+  [[nodiscard]] std::string_view View() const { return {m_Data, m_Size}; }
+  [[nodiscard]] const char *Data() const { return m_Data; }
+  [[nodiscard]] size_t Size() const { return m_Size; }
+  operator std::string_view() const { return View(); }
+  // false if the value could not be converted, e.g. a throwing toString
+  explicit operator bool() const { return m_Data != nullptr; }
+
+private:
+  // only set if m_Data belongs to the engine
+  JSContext *m_Ctx{nullptr};
+  const char *m_Data{nullptr};
+  size_t m_Size{0};
+  char m_Inline[24]{};
+  friend struct Value;
+};
+
 template <typename T> struct RawArray {
   T *Data{nullptr};
   size_t Size{0};
@@ -63,6 +188,8 @@ struct Value {
   struct FunctionData {
     Context Ctx;
     Func Function;
+    // results are recorded under this name if set, see Recorder.h
+    std::string Recorded{};
   };
 
   [[nodiscard]] Value Global() const;
@@ -70,14 +197,25 @@ struct Value {
   [[nodiscard]] Value Undefined() const;
   [[nodiscard]] Value Object() const;
   [[nodiscard]] Value NewArray() const;
-  [[nodiscard]] Value SharedArrayBuffer(size_t bytes) const;
+  // Native parser, see Json.h. Returns an exception value on invalid input
+  [[nodiscard]] Value FromJSON(std::string_view json) const;
+  // Backing store comes from the BufferPool (64-byte aligned)
+  [[nodiscard]] Value SharedArrayBuffer(size_t bytes, bool zeroed = true) const;
+  // Foreign memory, it has to outlive every JS reference to the buffer
   [[nodiscard]] Value SharedArrayBuffer(uint8_t *buf, size_t elements) const;
+  // Holds its own BufferPool reference until JS finalizes the buffer, the
+  // caller keeps its one
+  [[nodiscard]] Value PooledSharedArrayBuffer(uint8_t *buffer,
+                                              size_t bytes) const;
   template <typename T>
-  [[nodiscard]] Value TSharedArrayBuffer(const size_t elements) const {
-    return SharedArrayBuffer(elements * sizeof(T));
+  [[nodiscard]] Value TSharedArrayBuffer(const size_t elements,
+                                         const bool zeroed = true) const {
+    return SharedArrayBuffer(elements * sizeof(T), zeroed);
   }
 
+  // "null" if the value can't be converted, use Borrow to tell them apart
   [[nodiscard]] std::string AsString() const;
+  [[nodiscard]] BorrowedString Borrow() const;
   [[nodiscard]] double AsDouble() const;
   [[nodiscard]] bool AsBool() const;
   [[nodiscard]] int64_t AsInt() const;
@@ -92,6 +230,11 @@ struct Value {
   [[nodiscard]] std::vector<std::string> ObjectKeys() const;
 
   [[nodiscard]] RawArray<void> ToRawTypedArray() const;
+  // JSTypedArrayEnum of the value, -1 if it isn't a typed array
+  [[nodiscard]] int TypedArrayType() const;
+  // Type an array of elements with the given traits has, -1 if there's none
+  [[nodiscard]] static int TypedArrayTypeOf(size_t elementSize, bool floating,
+                                            bool isSigned);
   [[nodiscard]] RawArray<void> ToSharedArrayBuffer() const;
 
   [[nodiscard]] bool IsObject() const;
@@ -114,8 +257,17 @@ struct Value {
     return Call(argVec);
   }
 
+  // Int32Array for int32_t etc., Uint8ClampedArray counts as uint8_t
+  template <typename T> [[nodiscard]] bool IsTypedArray() const {
+    const int type = TypedArrayType();
+    return type >= 0 &&
+           type == TypedArrayTypeOf(sizeof(T), std::is_floating_point_v<T>,
+                                    std::is_signed_v<T>);
+  }
+
   template <typename T> [[nodiscard]] RawArray<T> AsTypedArray() const {
-    return static_cast<RawArray<T>>(ToRawTypedArray());
+    const auto raw = ToRawTypedArray();
+    return {static_cast<T *>(raw.Data), raw.Size};
   }
 
   void AddFunction(const std::string &name, const Func &, size_t args = 0);
@@ -125,11 +277,12 @@ struct Value {
   void Live() const;
 
   [[nodiscard]] Value ThrowException(const std::string &message) const;
-  [[nodiscard]] Value String(const std::string &data) const;
+  [[nodiscard]] Value String(std::string_view data) const;
   [[nodiscard]] Value Boolean(bool) const;
   [[nodiscard]] Value Number(double) const;
 
   [[nodiscard]] Runtime *GetRuntime() const;
+  [[nodiscard]] Instance *GetInstance() const;
 
   Value From(const JSValue *) const;
   static Value FromCtx(const Context &, JSValue *);
@@ -153,6 +306,14 @@ protected:
   JS::Value m_UnderlyingValue{};
   JS::Value m_Parent{};
   friend ValueUtils;
+  friend ClassBindingUtils;
+  friend ObjectProviderUtils;
+  friend Reflection;
+  friend Json;
+  friend Script;
+  friend Message;
+  friend Recorder;
+  friend CommandBuffer;
   friend Runtime;
 };
 
@@ -170,9 +331,40 @@ template <typename T> struct Array : RawArray<T> {
 };
 
 enum class ModuleType { Global = 0, Module = 1, Detect = -1 };
+
+// A module implemented in C++, e.g. import {left} from "native:audio".
+// Nothing is created until a script imports it for the first time,
+// Initialize then has to Set all Exports on the given object, exports of a
+// module without one are undefined.
+struct NativeModule {
+  typedef std::function<void(const Value &exports)> Init;
+  std::vector<std::string> Exports{};
+  Init Initialize{};
+  // Alternative for modules written directly against the QuickJS API
+  JSModuleDef *(*Create)(JSContext *, const char *name){nullptr};
+};
+
+// Compiled global script, see Instance::Compile. Run evaluates the bytecode
+// again without parsing and returns the completion value. Top level
+// let/const can't be declared twice, wrap those in a function.
+struct Script {
+  Script() = default;
+  explicit Script(const Value &function) : m_Function(function) {}
+  [[nodiscard]] Value Run() const;
+  // false if compiling failed, the exception is on the Context then
+  [[nodiscard]] bool IsValid() const;
+
+private:
+  Value m_Function{};
+};
+
 struct Instance {
+  // Return true to abort the running script
+  using MemoryCallback = std::function<bool(Instance &, const MemoryStats &)>;
+  using MetricsSink = std::function<void(Instance &, const MemoryStats &)>;
+
   [[nodiscard]] Value Global() const;
-  [[nodiscard]] Value String(const std::string &data) const;
+  [[nodiscard]] Value String(std::string_view data) const;
   [[nodiscard]] Value Double(double data) const;
   [[nodiscard]] Value Bool(bool data) const;
   [[nodiscard]] Value Int32(int32_t data) const;
@@ -183,27 +375,137 @@ struct Instance {
 
   // 0 == no limit
   void SetStackSize(int64_t size = 0);
-  explicit Instance(std::string name);
+
+  // Evaluates source as global script, same snippets are only compiled once
+  [[nodiscard]] Value Eval(std::string_view source,
+                           const std::string &name = "<eval>");
+  [[nodiscard]] Script Compile(std::string_view source,
+                               const std::string &name = "<eval>");
+  // Compiled scripts kept per Context, least recently used are dropped
+  void SetScriptCacheSize(size_t size);
+  [[nodiscard]] ScriptCacheStats GetScriptCacheStats() const;
+  explicit Instance(std::string name, bool privateHeap = true);
+  // Lightweight instance with its own globals on the runtime of share.
+  // Both have to be used from the same thread.
+  Instance(std::string name, const Instance &share);
   ~Instance();
   Instance(Instance &) = delete;
 
   Context &GetContext();
   std::string &GetName() { return m_Name; }
+  [[nodiscard]] HeapStats GetHeapStats() const;
+  [[nodiscard]] MemoryStats GetMemoryStats() const;
+
+  // Limits the whole runtime (shared with CreateInstance ones), 0 == no
+  // limit. Allocations above it fail with an out of memory error. Only the
+  // instance owning the runtime applies it, shared ones keep it as is.
+  // onExceeded runs once usage crosses warnAt * limit. It's only checked
+  // from the interrupt handler, so a single allocation can still run into
+  // the limit first. It must not run scripts.
+  void SetMemoryLimit(size_t limit, MemoryCallback onExceeded = {},
+                      float warnAt = 0.9f);
+  // The sink gets a sample at most every interval, from the running
+  // scripts or from SampleMemory. Shared instances only sample on
+  // SampleMemory, the interrupt handler belongs to the runtime owner.
+  void SetMetricsSink(MetricsSink sink, std::chrono::milliseconds interval);
+  void SampleMemory();
+
+  // GC runs per runtime, so this applies to CreateInstance ones as well.
+  // Frames keep the automatic GC out of time critical code, Idle collects
+  // if the estimated pause fits into budget and returns true if it did.
+  void SetGCPolicy(GCPolicy policy);
+  void BeginFrame();
+  void EndFrame();
+  bool Idle(std::chrono::microseconds budget);
+
+  // Binary copy of state that survives Runtime::Reset, keeps typed arrays,
+  // Maps, Sets and cycles intact:
+  //   Message saved;
+  //   (void)app.SnapshotState(app.Global()["state"], saved);
+  //   runtime.Reset();
+  //   app.Global().Set("state", app.RestoreState(saved));
+  // Returns the exception if state can't be cloned, undefined otherwise.
+  [[nodiscard]] Value SnapshotState(const Value &state, Message &out) const;
+  [[nodiscard]] Value RestoreState(const Message &snapshot) const;
+
+  // Logs host calls and native results for vqjs-replay, nullptr stops it.
+  // Set it before adding the native functions that should be replayed.
+  void SetRecorder(Ref<Recorder> recorder);
+
+  // Delivers messages of the Workers created by scripts of this instance,
+  // returns the count. Has to be called regularly, e.g. once per frame.
+  size_t Poll();
 
 protected:
   [[nodiscard]] Value LoadFile(const std::string &file, ModuleType type,
                                bool eval = true) const;
 
   void Reset();
+  // Exchanges the engine state (Context, functions, caches) with other
+  void Swap(Instance &other);
+
+  struct MemoryConfig {
+    size_t Limit{0};
+    float WarnAt{0.9f};
+    bool Warned{false};
+    MemoryCallback OnExceeded{};
+    MetricsSink Sink{};
+    std::chrono::milliseconds Interval{0};
+    std::chrono::steady_clock::time_point LastSample{};
+  };
+  MemoryConfig m_Memory{};
+  struct GCState {
+    bool InFrame{false};
+    size_t LastLive{0};
+    // moving average of the pause per live byte
+    double NsPerByte{0};
+  };
+  GCPolicy m_GCPolicy{};
+  GCState m_GC{};
+  Ref<Recorder> m_Recorder{};
+  // running ones, terminated ones are dropped by Poll
+  std::vector<Ref<Worker>> m_Workers{};
+  void TerminateWorkers();
+  // installs limit, interrupt handler and GC threshold on the current Context
+  void ApplyMemoryConfig();
+  static int OnInterrupt(JSRuntime *rt, void *opaque);
   std::string m_BaseDirectory{"./"};
   std::string m_Name{"Unknown"};
   Context m_Context;
+  bool m_SharedRuntime{false};
+  // instance that created the runtime, stays the same across Reset
+  Instance *m_Owner{this};
 
   std::unordered_map<std::string, Ref<Value::FunctionData>> m_Functions{};
+  // ClassDefinition (or ObjectProvider) -> JSClassID whose prototype is set
+  // on the current Context, the ids come from Context::GetClassID
+  std::unordered_map<const void *, std::pair<uint32_t, Ref<void>>>
+      m_Classes{};
+  // Reflect<T>::Names -> interned atoms, see Reflect.h
+  std::unordered_map<const void *, std::vector<uint32_t>> m_Shapes{};
+  void ReleaseShapes();
+
+  struct CachedScript {
+    uint64_t Hash;
+    std::string Source;
+    std::string Name;
+    Script Compiled;
+  };
+  std::list<CachedScript> m_ScriptOrder{};
+  std::unordered_map<uint64_t, std::list<CachedScript>::iterator> m_Scripts{};
+  size_t m_ScriptCacheSize{256};
+  ScriptCacheStats m_ScriptStats{};
+  void TrimScripts();
+  void ClearScripts();
 
   friend Value;
   friend Runtime;
   friend ValueUtils;
+  friend ClassBindingUtils;
+  friend Reflection;
+  friend Worker;
+  friend Scheduler;
+  friend struct Loader;
 };
 
 struct Runtime {
@@ -211,6 +513,14 @@ struct Runtime {
     std::string CoreDirectory = ".vqjs/";
     bool UseTypescript = true;
     std::vector<std::string> CompilerAddons;
+    // Keeps a prepared app instance built on a background thread, Reset
+    // only swaps it in and starts building the next one
+    bool PrewarmReset = false;
+    // Production mode, compiled functions (bundles included) don't keep
+    // their source text, toString doesn't return it anymore. The debug
+    // info goes as well unless KeepLineInfo, stacks have no lines then.
+    bool Strip = false;
+    bool KeepLineInfo = false;
   };
 
   struct ModuleLoader {
@@ -220,10 +530,16 @@ struct Runtime {
     };
     Resolved ResolvePath(const std::string &file) const;
     std::unordered_map<std::string, std::string> Paths;
+    std::unordered_map<std::string, NativeModule> NativeModules;
     ModuleLoader &Add(const std::string &, const std::string &);
+    ModuleLoader &AddNative(const std::string &name,
+                            std::vector<std::string> exports,
+                            NativeModule::Init init);
+    ModuleLoader &AddNative(const std::string &name, NativeModule module);
   };
 
   Runtime();
+  ~Runtime();
   Runtime(const Runtime &) = delete;
   Runtime(Runtime &&) = delete;
   bool Start();
@@ -234,6 +550,28 @@ struct Runtime {
 
   Instance &GetInstance();
   Instance &GetCompilerInstance();
+  // Additional instance on the app runtime, e.g. one per plugin. Has to be
+  // created again after Reset, old ones keep the previous runtime alive.
+  [[nodiscard]] Ref<Instance> CreateInstance(const std::string &name);
+  // Instance with its own runtime, prepared like the app one. Has to be
+  // used on the thread that created it. Other threads must pass the base
+  // directory and a copy of the config, the app instance and GetConfig
+  // aren't theirs to read.
+  [[nodiscard]] Ref<Instance> CreateIsolatedInstance(const std::string &name,
+                                                     bool privateHeap = true);
+  [[nodiscard]] Ref<Instance>
+  CreateIsolatedInstance(const std::string &name, bool privateHeap,
+                         const std::string &baseDirectory,
+                         const Config &config);
+
+  // Modules are taken from the bundle first, without touching the file
+  // system. Call it before Start, the TS compiler isn't needed with a
+  // complete bundle (Config::UseTypescript = false).
+  bool LoadBundle(const std::string &file);
+  // Compiles entries and everything they import into one bundle, needs a
+  // started runtime with the same loader paths as the one loading it
+  bool WriteBundle(const std::string &file,
+                   const std::vector<std::string> &entries);
 
   void SetIncludeDirectory(const std::string &directory);
   void SetLogger(Ref<Logger> &logger);
@@ -247,6 +585,19 @@ protected:
   Instance m_AppInstance{"App"};
   ModuleLoader m_ModuleLoader{};
   Ref<Logger> m_Logger{};
+  Ref<Bundle> m_Bundle{};
+  // only set while WriteBundle runs, collects every compiled module
+  BundleWriter *m_Recording{nullptr};
+  // the compiler instance is shared with the worker threads
+  mutable std::mutex m_CompileMutex{};
+  // Config::Strip flags the standby is built with, Reset doesn't use it if
+  // they changed in the meantime
+  int m_StandbyStrip{0};
+  // last member, waits for a running build before the rest is destroyed
+  std::future<Ref<Instance>> m_Standby{};
+  void PrepareApp(Instance &instance, const Config &config);
+
+  friend Instance;
 };
 
 } // namespace VQJS
@@ -0,0 +1,192 @@
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace VQJS {
+
+static constexpr size_t Mask = AsyncLogger::SlotCount - 1;
+static_assert((AsyncLogger::SlotCount & Mask) == 0,
+              "SlotCount has to be a power of two");
+
+static constexpr std::string_view Prefix(const Logger::Level level) {
+  switch (level) {
+  case Logger::Level::Debug: return "[VQJS][Debug] >> ";
+  case Logger::Level::Info: return "[VQJS][Info] >> ";
+  case Logger::Level::Warn: return "[VQJS][Warn] >> ";
+  case Logger::Level::Error: return "[VQJS][Error] >> ";
+  }
+  return "";
+}
+
+AsyncLogger::AsyncLogger(Ref<Logger> sink,
+                         const std::chrono::milliseconds interval)
+    : m_Slots(std::make_unique<Slot[]>(SlotCount)),
+      m_Sink(std::move(sink)),
+      m_Interval(interval) {
+  for (size_t i = 0; i < SlotCount; i++)
+    m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+  // formatting reuses these, so they only grow at the beginning
+  m_Out.reserve(SlotCount * 32);
+  m_Err.reserve(SlotCount * 8);
+  m_Line.reserve(MaxLineSize);
+  m_Thread = std::thread(&AsyncLogger::Run, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Wake.notify_one();
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+void AsyncLogger::Info(const std::string &lines) {
+  Log(Level::Info, lines);
+}
+void AsyncLogger::Debug(const std::string &lines) {
+  Log(Level::Debug, lines);
+}
+void AsyncLogger::Error(const std::string &lines) {
+  Log(Level::Error, lines);
+}
+void AsyncLogger::Warn(const std::string &lines) {
+  Log(Level::Warn, lines);
+}
+
+void AsyncLogger::Log(const Level level, std::string_view line) {
+  if (!Enabled(level))
+    return;
+  if (line.size() > MaxLineSize)
+    line = line.substr(0, MaxLineSize);
+  const size_t count =
+      line.empty() ? 1 : (line.size() + SlotSize - 1) / SlotSize;
+  size_t pos = m_Tail.load(std::memory_order_relaxed);
+  while (true) {
+    const size_t seq = m_Slots[pos & Mask].Sequence.load(
+        std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0 && count > 1) {
+      // Drain frees in order, if the last one is free all of them are
+      const size_t last = pos + count - 1;
+      const size_t lastSeq = m_Slots[last & Mask].Sequence.load(
+          std::memory_order_acquire);
+      diff = static_cast<intptr_t>(lastSeq) - static_cast<intptr_t>(last);
+    }
+    if (diff == 0) {
+      if (m_Tail.compare_exchange_weak(pos, pos + count,
+                                       std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // full, the consumer didn't catch up yet
+      m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = m_Tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  Slot &first = m_Slots[pos & Mask];
+  first.Severity = level;
+  first.Size = static_cast<uint32_t>(line.size());
+  for (size_t i = 0; i < count; i++) {
+    const auto part = line.substr(i * SlotSize, SlotSize);
+    std::memcpy(m_Slots[(pos + i) & Mask].Data, part.data(), part.size());
+  }
+  // only the first one is published, it covers the rest
+  first.Sequence.store(pos + 1, std::memory_order_release);
+
+  // don't wait for the interval if the ring is filling up
+  const auto backlog = static_cast<intptr_t>(
+      pos - m_Head.load(std::memory_order_relaxed));
+  if (backlog >= static_cast<intptr_t>(SlotCount / 2) &&
+      !m_Urgent.exchange(true))
+    m_Wake.notify_one();
+}
+
+void AsyncLogger::Flush() {
+  const size_t target = m_Tail.load(std::memory_order_acquire);
+  m_Urgent = true;
+  m_Wake.notify_one();
+  std::unique_lock lock(m_Mutex);
+  m_Drained.wait(lock, [this, target] {
+    return m_Stop || m_Head.load(std::memory_order_acquire) >= target;
+  });
+}
+
+void AsyncLogger::Write(const Level level, const std::string_view line) {
+  if (m_Sink) {
+    m_Sink->Log(level, line);
+    return;
+  }
+  std::string &out = level == Level::Error ? m_Err : m_Out;
+  out.append(Prefix(level));
+  out.append(line);
+  out.push_back('\n');
+}
+
+size_t AsyncLogger::Drain() {
+  size_t head = m_Head.load(std::memory_order_relaxed);
+  size_t count = 0;
+  while (true) {
+    Slot &slot = m_Slots[head & Mask];
+    if (slot.Sequence.load(std::memory_order_acquire) != head + 1)
+      break;
+    const size_t slots =
+        slot.Size == 0 ? 1 : (slot.Size + SlotSize - 1) / SlotSize;
+    if (slots == 1) {
+      Write(slot.Severity, {slot.Data, slot.Size});
+    } else {
+      m_Line.clear();
+      for (size_t i = 0; i < slots; i++) {
+        const size_t size = std::min<size_t>(slot.Size - i * SlotSize,
+                                             SlotSize);
+        m_Line.append(m_Slots[(head + i) & Mask].Data, size);
+      }
+      Write(slot.Severity, m_Line);
+    }
+    // in order, Log only checks the last slot a line needs
+    for (size_t i = 0; i < slots; i++) {
+      m_Slots[(head + i) & Mask].Sequence.store(head + i + SlotCount,
+                                                std::memory_order_release);
+    }
+    head += slots;
+    m_Head.store(head, std::memory_order_release);
+    count++;
+  }
+  // one write per stream and batch
+  if (!m_Out.empty()) {
+    std::fwrite(m_Out.data(), 1, m_Out.size(), stdout);
+    std::fflush(stdout);
+    m_Out.clear();
+  }
+  if (!m_Err.empty()) {
+    std::fwrite(m_Err.data(), 1, m_Err.size(), stderr);
+    m_Err.clear();
+  }
+  return count;
+}
+
+void AsyncLogger::Run() {
+  while (true) {
+    bool stop;
+    {
+      std::unique_lock lock(m_Mutex);
+      m_Wake.wait_for(lock, m_Interval,
+                      [this] { return m_Stop || m_Urgent.load(); });
+      m_Urgent = false;
+      stop = m_Stop;
+    }
+    Drain();
+    {
+      std::lock_guard lock(m_Mutex);
+      m_Drained.notify_all();
+    }
+    if (stop)
+      return;
+  }
+}
+} // namespace VQJS
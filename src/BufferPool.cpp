@@ -0,0 +1,138 @@
+#include "BufferPool.h"
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <mimalloc/include/mimalloc.h>
+#include <new>
+
+namespace VQJS {
+
+// Sits directly in front of the data, inside the alignment padding
+struct BufferHeader {
+  uint32_t Magic;
+  uint32_t SizeClass;
+  size_t Capacity;
+  std::atomic<uint32_t> RefCount;
+};
+
+static constexpr uint32_t HeaderMagic = 0x5651424Bu;
+static constexpr uint32_t Unpooled = UINT32_MAX;
+
+static BufferHeader *HeaderOf(const uint8_t *buffer) {
+  return reinterpret_cast<BufferHeader *>(const_cast<uint8_t *>(buffer) -
+                                          sizeof(BufferHeader));
+}
+
+static size_t PrefixOf(const size_t capacity) {
+  return capacity >= BufferPool::LargeSize ? BufferPool::PageSize
+                                           : BufferPool::Alignment;
+}
+
+static size_t RoundUp(const size_t value, const size_t to) {
+  return (value + to - 1) & ~(to - 1);
+}
+
+// Never destroyed, buffers can still be finalized by runtimes that outlive
+// static destruction
+BufferPool &BufferPool::Get() {
+  static auto *pool = new BufferPool();
+  return *pool;
+}
+
+uint8_t *BufferPool::Allocate(const size_t bytes, const bool zeroed) {
+  uint32_t sizeClass = Unpooled;
+  size_t capacity = RoundUp(bytes == 0 ? 1 : bytes, PageSize);
+  if (bytes <= MaxPooledSize) {
+    capacity = std::bit_ceil(bytes < Alignment ? Alignment : bytes);
+    sizeClass = std::countr_zero(capacity) - MinShift;
+
+    std::unique_lock lock(m_Mutex);
+    auto &list = m_Free[sizeClass];
+    if (!list.empty()) {
+      uint8_t *buffer = list.back();
+      list.pop_back();
+      m_CachedBytes -= capacity;
+      m_CachedCount--;
+      lock.unlock();
+      HeaderOf(buffer)->RefCount.store(1, std::memory_order_relaxed);
+      if (zeroed)
+        std::memset(buffer, 0, bytes);
+      return buffer;
+    }
+  }
+
+  const size_t prefix = PrefixOf(capacity);
+  auto *block = static_cast<uint8_t *>(
+      zeroed ? mi_zalloc_aligned(prefix + capacity, prefix)
+             : mi_malloc_aligned(prefix + capacity, prefix));
+  if (!block)
+    return nullptr;
+  uint8_t *buffer = block + prefix;
+  new (HeaderOf(buffer)) BufferHeader{HeaderMagic, sizeClass, capacity, 1};
+  std::lock_guard lock(m_Mutex);
+  m_Blocks.insert(buffer);
+  return buffer;
+}
+
+void BufferPool::Retain(uint8_t *buffer) {
+  assert(HeaderOf(buffer)->Magic == HeaderMagic);
+  HeaderOf(buffer)->RefCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BufferPool::Release(uint8_t *buffer) {
+  if (!buffer)
+    return;
+  BufferHeader *header = HeaderOf(buffer);
+  assert(header->Magic == HeaderMagic);
+  if (header->RefCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  std::lock_guard lock(m_Mutex);
+  if (header->SizeClass != Unpooled &&
+      m_CachedBytes + header->Capacity <= MaxCachedBytes) {
+    m_Free[header->SizeClass].push_back(buffer);
+    m_CachedBytes += header->Capacity;
+    m_CachedCount++;
+    return;
+  }
+  FreeBlock(buffer);
+}
+
+// m_Mutex has to be held
+void BufferPool::FreeBlock(uint8_t *buffer) {
+  m_Blocks.erase(buffer);
+  mi_free(buffer - PrefixOf(HeaderOf(buffer)->Capacity));
+}
+
+void BufferPool::Trim() {
+  std::lock_guard lock(m_Mutex);
+  for (auto &list : m_Free) {
+    for (auto *buffer : list) {
+      FreeBlock(buffer);
+    }
+    list.clear();
+  }
+  m_CachedBytes = 0;
+  m_CachedCount = 0;
+}
+
+bool BufferPool::Owns(const uint8_t *buffer) const {
+  std::lock_guard lock(m_Mutex);
+  return m_Blocks.contains(buffer);
+}
+
+size_t BufferPool::CachedBytes() const {
+  std::lock_guard lock(m_Mutex);
+  return m_CachedBytes;
+}
+
+size_t BufferPool::LiveBuffers() const {
+  std::lock_guard lock(m_Mutex);
+  return m_Blocks.size() - m_CachedCount;
+}
+
+size_t BufferPool::Capacity(const uint8_t *buffer) {
+  return HeaderOf(buffer)->Capacity;
+}
+} // namespace VQJS
@@ -0,0 +1,94 @@
+#include "Bundle.h"
+
+#include <algorithm>
+#include <fstream>
+#include <ranges>
+
+namespace VQJS {
+
+void BundleWriter::Add(const std::string &name, const uint8_t *data,
+                       const size_t size) {
+  m_Modules[name].assign(data, data + size);
+}
+
+bool BundleWriter::Write(const std::string &file, const uint32_t flags) const {
+  const auto count = static_cast<uint32_t>(m_Modules.size());
+  size_t names = sizeof(Bundle::Header) + count * sizeof(Bundle::Entry);
+  size_t data = names;
+  for (const auto &[name, code] : m_Modules)
+    data += name.size();
+
+  std::vector<Bundle::Entry> entries;
+  entries.reserve(count);
+  for (const auto &[name, code] : m_Modules) {
+    entries.push_back({static_cast<uint32_t>(names),
+                       static_cast<uint32_t>(name.size()),
+                       static_cast<uint32_t>(data),
+                       static_cast<uint32_t>(code.size())});
+    names += name.size();
+    data += code.size();
+  }
+  // offsets are 32 bit
+  if (data > UINT32_MAX)
+    return false;
+
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    return false;
+  const Bundle::Header header{Bundle::Magic, Bundle::Version, count, flags};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            static_cast<std::streamsize>(count * sizeof(Bundle::Entry)));
+  for (const auto &name : m_Modules | std::views::keys)
+    out.write(name.data(), static_cast<std::streamsize>(name.size()));
+  for (const auto &code : m_Modules | std::views::values)
+    out.write(reinterpret_cast<const char *>(code.data()),
+              static_cast<std::streamsize>(code.size()));
+  return out.good();
+}
+
+bool Bundle::Open(const std::string &file) {
+  m_Entries = nullptr;
+  m_Count = 0;
+  m_Flags = 0;
+  if (!m_File.Open(file) || m_File.Size() < sizeof(Header))
+    return false;
+  const auto *header = reinterpret_cast<const Header *>(m_File.Data());
+  if (header->Magic != Magic || header->Version != Version ||
+      m_File.Size() < sizeof(Header) + header->Count * sizeof(Entry)) {
+    m_File.Close();
+    return false;
+  }
+  const auto *entries =
+      reinterpret_cast<const Entry *>(m_File.Data() + sizeof(Header));
+  // checked once here, so Find doesn't have to
+  for (uint32_t i = 0; i < header->Count; i++) {
+    const Entry &entry = entries[i];
+    if (size_t{entry.NameOffset} + entry.NameSize > m_File.Size() ||
+        size_t{entry.DataOffset} + entry.DataSize > m_File.Size()) {
+      m_File.Close();
+      return false;
+    }
+  }
+  m_Entries = entries;
+  m_Count = header->Count;
+  m_Flags = header->Flags;
+  return true;
+}
+
+std::string_view Bundle::Name(const Entry &entry) const {
+  return {reinterpret_cast<const char *>(m_File.Data()) + entry.NameOffset,
+          entry.NameSize};
+}
+
+std::span<const uint8_t> Bundle::Find(const std::string_view name) const {
+  const Entry *end = m_Entries + m_Count;
+  const Entry *found = std::lower_bound(
+      m_Entries, end, name, [this](const Entry &entry, std::string_view key) {
+        return Name(entry) < key;
+      });
+  if (found == end || Name(*found) != name)
+    return {};
+  return {m_File.Data() + found->DataOffset, found->DataSize};
+}
+} // namespace VQJS
@@ -0,0 +1,240 @@
+#include "ClassBinding.h"
+#include "impl.h"
+
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+// What a JS object of a bound class carries around as opaque
+struct ClassObject {
+  void *Ptr;
+  Ref<void> Owner;
+  Ref<ClassDefinition> Definition;
+};
+
+struct ClassBindingUtils {
+  static Instance *GetInstance(JSContext *ctx) {
+    return static_cast<Instance *>(JS_GetContextOpaque(ctx));
+  }
+
+  static ClassObject *GetObject(JSContext *ctx, JSValueConst thisVal,
+                                JSValueConst *data) {
+    int32_t id = 0;
+    JS_ToInt32(ctx, &id, data[0]);
+    // throws a TypeError if someone calls the method on a foreign object
+    return static_cast<ClassObject *>(
+        JS_GetOpaque2(ctx, thisVal, static_cast<JSClassID>(id)));
+  }
+
+  static std::vector<Value> GetArgs(const Context &context, int argc,
+                                    JSValueConst *argv) {
+    std::vector<Value> args;
+    args.reserve(argc);
+    for (int i = 0; i < argc; i++)
+      args.push_back(Value::FromCtx(context, &argv[i]));
+    return args;
+  }
+
+  static JSValue Return(JSContext *ctx, const Value &value) {
+    return JS_DupValue(ctx, TO(value.m_UnderlyingValue));
+  }
+
+  static JSValue Call(JSContext *ctx, JSValueConst thisVal, int argc,
+                      JSValueConst *argv, int magic, JSValueConst *data) {
+    auto *object = GetObject(ctx, thisVal, data);
+    if (!object)
+      return JS_EXCEPTION;
+    const Context &context = GetInstance(ctx)->GetContext();
+    const auto &method = object->Definition->Methods[magic];
+    return Return(ctx, method.Call(object->Ptr,
+                                   Value::FromCtx(context, &thisVal),
+                                   GetArgs(context, argc, argv)));
+  }
+
+  static JSValue Get(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *,
+                     int magic, JSValueConst *data) {
+    auto *object = GetObject(ctx, thisVal, data);
+    if (!object)
+      return JS_EXCEPTION;
+    const Context &context = GetInstance(ctx)->GetContext();
+    const auto &property = object->Definition->Properties[magic];
+    return Return(
+        ctx, property.Get(object->Ptr, Value::FromCtx(context, &thisVal)));
+  }
+
+  static JSValue Set(JSContext *ctx, JSValueConst thisVal, int,
+                     JSValueConst *argv, int magic, JSValueConst *data) {
+    auto *object = GetObject(ctx, thisVal, data);
+    if (!object)
+      return JS_EXCEPTION;
+    const Context &context = GetInstance(ctx)->GetContext();
+    const auto &property = object->Definition->Properties[magic];
+    property.Set(object->Ptr, Value::FromCtx(context, &thisVal),
+                 Value::FromCtx(context, &argv[0]));
+    // setters can only report errors by throwing
+    return JS_HasException(ctx) ? JS_EXCEPTION : JS_UNDEFINED;
+  }
+
+  static JSValue Construct(JSContext *ctx, JSValueConst thisVal, int argc,
+                           JSValueConst *argv, int, JSValueConst *data) {
+    int32_t id = 0;
+    JS_ToInt32(ctx, &id, data[0]);
+    auto *instance = GetInstance(ctx);
+    const Context &context = instance->GetContext();
+    Ref<ClassDefinition> definition{};
+    for (const auto &[key, entry] : instance->m_Classes) {
+      if (entry.first == static_cast<uint32_t>(id)) {
+        definition = std::static_pointer_cast<ClassDefinition>(entry.second);
+        break;
+      }
+    }
+    if (!definition || !definition->Construct)
+      return JS_ThrowTypeError(ctx, "class is not constructable");
+
+    auto owner = definition->Construct(Value::FromCtx(context, &thisVal),
+                                       GetArgs(context, argc, argv));
+    if (JS_HasException(ctx))
+      return JS_EXCEPTION;
+    if (!owner)
+      return JS_ThrowTypeError(ctx, "failed to construct %s",
+                               definition->Name.c_str());
+    // new_target, derived classes bring their own prototype
+    JSValue proto = JS_GetPropertyStr(ctx, thisVal, "prototype");
+    if (JS_IsException(proto))
+      return JS_EXCEPTION;
+    if (!JS_IsObject(proto)) {
+      JS_FreeValue(ctx, proto);
+      proto = JS_GetClassProto(ctx, id);
+    }
+    JSValue obj = JS_NewObjectProtoClass(ctx, proto, id);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(obj))
+      return JS_EXCEPTION;
+    void *ptr = owner.get();
+    JS_SetOpaque(obj, new ClassObject{ptr, std::move(owner), definition});
+    return obj;
+  }
+
+  static void Finalize(JSRuntime *, JSValue val) {
+    JSClassID id = 0;
+    auto *object = static_cast<ClassObject *>(JS_GetAnyOpaque(val, &id));
+    if (!object)
+      return;
+    if (object->Definition->Finalize)
+      object->Definition->Finalize(object->Ptr);
+    delete object;
+  }
+
+  static uint32_t Register(Instance &instance,
+                           const Ref<ClassDefinition> &definition) {
+    auto &classes = instance.m_Classes;
+    if (const auto it = classes.find(definition.get()); it != classes.end())
+      return it->second.first;
+
+    // the class is registered once per runtime, the prototype once per
+    // Context on it
+    const Context &context = instance.GetContext();
+    JSContext *ctx = context;
+    JSClassID id = context.GetClassID(definition.get());
+    if (id == 0) {
+      JSRuntime *rt = context;
+      JS_NewClassID(rt, &id);
+      JSClassDef def{};
+      def.class_name = definition->Name.c_str();
+      def.finalizer = &Finalize;
+      JS_NewClass(rt, id, &def);
+      context.SetClassID(definition.get(), id, definition);
+    }
+
+    JSValue idValue = JS_NewInt32(ctx, static_cast<int32_t>(id));
+    JSValue proto = JS_NewObject(ctx);
+    const auto &methods = definition->Methods;
+    for (size_t i = 0; i < methods.size(); i++) {
+      JSValue fn =
+          JS_NewCFunctionData(ctx, &Call, static_cast<int>(methods[i].Args),
+                              static_cast<int>(i), 1, &idValue);
+      JS_DefinePropertyValueStr(ctx, proto, methods[i].Name.c_str(), fn,
+                                JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+    const auto &properties = definition->Properties;
+    for (size_t i = 0; i < properties.size(); i++) {
+      JSValue getter = JS_NewCFunctionData(ctx, &Get, 0, static_cast<int>(i),
+                                           1, &idValue);
+      JSValue setter = properties[i].Set
+                           ? JS_NewCFunctionData(ctx, &Set, 1,
+                                                 static_cast<int>(i), 1,
+                                                 &idValue)
+                           : JS_UNDEFINED;
+      JSAtom atom = JS_NewAtom(ctx, properties[i].Name.c_str());
+      JS_DefinePropertyGetSet(ctx, proto, atom, getter, setter,
+                              JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+      JS_FreeAtom(ctx, atom);
+    }
+    JS_SetClassProto(ctx, id, proto);
+    JS_FreeValue(ctx, idValue);
+
+    classes[definition.get()] = {id, definition};
+    return id;
+  }
+
+  static void *Unwrap(const Value &value,
+                      const Ref<ClassDefinition> &definition) {
+    JSContext *ctx = value.m_Context;
+    if (!ctx)
+      return nullptr;
+    // objects of sibling instances on the runtime share the id
+    const uint32_t id = value.m_Context.GetClassID(definition.get());
+    if (id == 0)
+      return nullptr;
+    auto *object = static_cast<ClassObject *>(
+        JS_GetOpaque(TO(value.m_UnderlyingValue), id));
+    return object ? object->Ptr : nullptr;
+  }
+};
+
+ClassBindingBase::ClassBindingBase(std::string name)
+    : m_Definition(CreateRef<ClassDefinition>()) {
+  m_Definition->Name = std::move(name);
+}
+
+uint32_t ClassBindingBase::Register(Instance &instance) const {
+  return ClassBindingUtils::Register(instance, m_Definition);
+}
+
+void *ClassBindingBase::Unwrap(const Value &value) const {
+  return ClassBindingUtils::Unwrap(value, m_Definition);
+}
+
+Value ClassBindingBase::Wrap(Instance &instance, void *object,
+                             Ref<void> owner) const {
+  const JSClassID id = Register(instance);
+  JSContext *ctx = instance.GetContext();
+  JSValue obj = JS_NewObjectClass(ctx, static_cast<int>(id));
+  JS_SetOpaque(obj, new ClassObject{object, std::move(owner), m_Definition});
+  return Value(instance.GetContext(), FROM(obj));
+}
+
+Value ClassBindingBase::Constructor(Instance &instance) const {
+  const JSClassID id = Register(instance);
+  JSContext *ctx = instance.GetContext();
+  JSValue idValue = JS_NewInt32(ctx, static_cast<int32_t>(id));
+  JSValue fn = JS_NewCFunctionData(ctx, &ClassBindingUtils::Construct, 0, 0,
+                                   1, &idValue);
+  JS_FreeValue(ctx, idValue);
+  JS_SetConstructorBit(ctx, fn, true);
+
+  // wire up prototype <-> constructor so instanceof works
+  JSValue proto = JS_GetClassProto(ctx, id);
+  JS_DefinePropertyValueStr(ctx, fn, "prototype", JS_DupValue(ctx, proto), 0);
+  JS_DefinePropertyValueStr(ctx, proto, "constructor", JS_DupValue(ctx, fn),
+                            JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+  JS_FreeValue(ctx, proto);
+  return Value(instance.GetContext(), FROM(fn));
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
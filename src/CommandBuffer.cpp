@@ -0,0 +1,128 @@
+#include "CommandBuffer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <quickjs/quickjs.h>
+#include <string>
+#include <string_view>
+
+namespace VQJS {
+
+static std::string GenerateEncoder(const std::vector<std::string> &methods,
+                                   const size_t capacity) {
+  std::string source = R"((function () {
+  class CommandEncoder {
+    constructor(capacity) {
+      this.data = new Float64Array(new SharedArrayBuffer(capacity * 8));
+      this.length = 0;
+    }
+    reserve(count) {
+      const offset = this.length;
+      if (offset + count > this.data.length) {
+        let size = this.data.length * 2;
+        while (size < offset + count) size *= 2;
+        const data = new Float64Array(new SharedArrayBuffer(size * 8));
+        data.set(this.data.subarray(0, offset));
+        this.data = data;
+      }
+      this.length = offset + count;
+      return offset;
+    }
+)";
+  for (const auto &method : methods) {
+    source += method;
+  }
+  source += "  }\n  return new CommandEncoder(" + std::to_string(capacity) +
+            ");\n})()";
+  return source;
+}
+
+CommandBuffer::CommandBuffer(const size_t capacity)
+    : m_Capacity(capacity == 0 ? 1 : capacity) {}
+
+// The name goes straight into the encoder source, so nothing but plain
+// identifiers. The members of CommandEncoder itself are taken.
+static bool IsValidName(const std::string &name) {
+  static constexpr std::string_view Reserved[] = {"constructor", "reserve",
+                                                   "data", "length"};
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+    return false;
+  for (const char c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '$')
+      return false;
+  }
+  return std::find(std::begin(Reserved), std::end(Reserved), name) ==
+         std::end(Reserved);
+}
+
+uint32_t CommandBuffer::Register(const std::string &name,
+                                 const uint32_t argCount, Decoder decoder) {
+  if (!IsValidName(name))
+    return InvalidOpcode;
+  for (const auto &command : m_Commands) {
+    if (command.Name == name)
+      return InvalidOpcode;
+  }
+  m_Commands.push_back({name, argCount, std::move(decoder)});
+  return static_cast<uint32_t>(m_Commands.size() - 1);
+}
+
+Value CommandBuffer::CreateEncoder(Instance &instance) {
+  std::vector<std::string> methods;
+  methods.reserve(m_Commands.size());
+  for (uint32_t opcode = 0; opcode < m_Commands.size(); opcode++) {
+    const auto &command = m_Commands[opcode];
+    std::string params;
+    std::string body;
+    for (uint32_t i = 0; i < command.ArgCount; i++) {
+      const std::string arg = "a" + std::to_string(i);
+      params += (i == 0 ? "" : ", ") + arg;
+      body += " d[i + " + std::to_string(i + 1) + "] = " + arg + ";";
+    }
+    methods.push_back("    " + command.Name + "(" + params +
+                      ") { const i = this.reserve(" +
+                      std::to_string(command.ArgCount + 1) +
+                      "); const d = this.data; d[i] = " +
+                      std::to_string(opcode) + ";" + body + " }\n");
+  }
+
+  const std::string source = GenerateEncoder(methods, m_Capacity);
+  JSContext *ctx = instance.GetContext();
+  JSValue encoder = JS_Eval(ctx, source.c_str(), source.size(),
+                            "<command-encoder>", JS_EVAL_TYPE_GLOBAL);
+  m_Encoder = Value::FromCtx(instance.GetContext(), &encoder);
+  JS_FreeValue(ctx, encoder);
+  return m_Encoder;
+}
+
+size_t CommandBuffer::Drain(Instance &instance) {
+  if (!m_Encoder.IsObject())
+    return 0;
+  // the encoder would keep the old runtime alive
+  if (static_cast<JSContext *>(m_Encoder.m_Context) !=
+      static_cast<JSContext *>(instance.GetContext())) {
+    m_Encoder = Value{};
+    return 0;
+  }
+  // keep the view alive while we are reading from it
+  const Value view = m_Encoder["data"];
+  const auto data = view.AsTypedArray<double>();
+  const auto length = static_cast<size_t>(m_Encoder["length"].AsInt());
+  if (length > data.Size)
+    return 0;
+
+  size_t count = 0;
+  for (size_t i = 0; i < length; count++) {
+    const auto opcode = static_cast<uint32_t>(data.Data[i]);
+    if (opcode >= m_Commands.size())
+      break;
+    const auto &command = m_Commands[opcode];
+    if (i + 1 + command.ArgCount > length)
+      break;
+    command.Decode({data.Data + i + 1, command.ArgCount});
+    i += 1 + command.ArgCount;
+  }
+  m_Encoder.Set("length", m_Encoder.Number(0));
+  return count;
+}
+} // namespace VQJS
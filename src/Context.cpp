@@ -1,31 +1,190 @@
+#include "BufferPool.h"
 #include "quickjs/quickjs.h"
 #include "vqjs.h"
 
+#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <mimalloc/include/mimalloc.h>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace VQJS {
 
+// Malloc opaque of a runtime. mimalloc heaps can only allocate on the thread
+// that created them, everything else goes to the default heap. mi_free works
+// for both.
+struct ContextHeap {
+  mi_heap_t *Heap{nullptr};
+  std::thread::id Owner{};
+  std::atomic<size_t> Live{0};
+  std::atomic<size_t> Peak{0};
+  std::atomic<size_t> Count{0};
+  std::atomic<size_t> Total{0};
+  // see Context::GetClassID, only used from the thread owning the runtime
+  std::unordered_map<const void *, std::pair<uint32_t, Ref<void>>> Classes{};
+
+  [[nodiscard]] mi_heap_t *Get() const {
+    return Heap && std::this_thread::get_id() == Owner ? Heap : nullptr;
+  }
+
+  void Grow(const size_t size) {
+    const size_t live = Live.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = Peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !Peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+      ;
+  }
+
+  void Added(const void *ptr) {
+    if (!ptr)
+      return;
+    Grow(mi_usable_size(ptr));
+    Count.fetch_add(1, std::memory_order_relaxed);
+    Total.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Removed(const void *ptr) {
+    Live.fetch_sub(mi_usable_size(ptr), std::memory_order_relaxed);
+    Count.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
 static void *Calloc(void *opaque, size_t count, size_t size) {
-  return mi_calloc(count, size);
+  auto *heap = static_cast<ContextHeap *>(opaque);
+  mi_heap_t *mi = heap->Get();
+  void *ptr = mi ? mi_heap_calloc(mi, count, size) : mi_calloc(count, size);
+  heap->Added(ptr);
+  return ptr;
 }
 
-static void *Malloc(void *opaque, size_t size) { return mi_malloc(size); }
+static void *Malloc(void *opaque, size_t size) {
+  auto *heap = static_cast<ContextHeap *>(opaque);
+  mi_heap_t *mi = heap->Get();
+  void *ptr = mi ? mi_heap_malloc(mi, size) : mi_malloc(size);
+  heap->Added(ptr);
+  return ptr;
+}
 
 static void Free(void *opaque, void *ptr) {
   if (!ptr)
     return;
+  static_cast<ContextHeap *>(opaque)->Removed(ptr);
   mi_free(ptr);
 }
 
 static void *Realloc(void *opaque, void *ptr, size_t size) {
-  return mi_realloc(ptr, size);
+  auto *heap = static_cast<ContextHeap *>(opaque);
+  mi_heap_t *mi = heap->Get();
+  if (!ptr) {
+    void *result = mi ? mi_heap_malloc(mi, size) : mi_malloc(size);
+    heap->Added(result);
+    return result;
+  }
+  const size_t before = mi_usable_size(ptr);
+  void *result = mi ? mi_heap_realloc(mi, ptr, size) : mi_realloc(ptr, size);
+  // ptr stays valid on failure
+  if (!result)
+    return nullptr;
+  heap->Live.fetch_sub(before, std::memory_order_relaxed);
+  heap->Grow(mi_usable_size(result));
+  return result;
+}
+
+// Private heaps released on another thread, mimalloc only lets the owner
+// destroy them. The owner does it the next time it creates or destroys one,
+// or when it exits. Never destroyed, like the BufferPool.
+struct OrphanHeaps {
+  std::mutex Mutex;
+  std::vector<std::pair<std::thread::id, mi_heap_t *>> Heaps;
+};
+
+static OrphanHeaps &GetOrphans() {
+  static auto *orphans = new OrphanHeaps();
+  return *orphans;
+}
+
+static void DestroyOrphans() {
+  auto &orphans = GetOrphans();
+  std::vector<mi_heap_t *> owned;
+  {
+    std::lock_guard lock(orphans.Mutex);
+    if (orphans.Heaps.empty())
+      return;
+    const auto self = std::this_thread::get_id();
+    std::erase_if(orphans.Heaps, [&](const auto &orphan) {
+      if (orphan.first != self)
+        return false;
+      owned.push_back(orphan.second);
+      return true;
+    });
+  }
+  for (auto *heap : owned)
+    mi_heap_destroy(heap);
+}
+
+// a new thread could get the id of an exited owner, nothing may be left
+struct OrphanGuard {
+  ~OrphanGuard() { DestroyOrphans(); }
+};
+
+static ContextHeap *CreateHeap(const bool privateHeap) {
+  DestroyOrphans();
+  auto *heap = new ContextHeap();
+  if (privateHeap) {
+    static thread_local OrphanGuard guard;
+    (void)guard;
+    heap->Heap = mi_heap_new();
+    heap->Owner = std::this_thread::get_id();
+  }
+  return heap;
+}
+
+static void DestroyHeap(ContextHeap *heap) {
+  // JS_FreeRuntime freed every object already, this drops leftovers and
+  // hands the pages back in one go
+  if (heap->Heap) {
+    if (std::this_thread::get_id() == heap->Owner) {
+      mi_heap_destroy(heap->Heap);
+    } else {
+      auto &orphans = GetOrphans();
+      std::lock_guard lock(orphans.Mutex);
+      orphans.Heaps.emplace_back(heap->Owner, heap->Heap);
+    }
+  }
+  delete heap;
+  DestroyOrphans();
 }
 
-static JSRuntime *CreateRuntime() {
+// SharedArrayBuffers created by scripts come from the BufferPool, the
+// reference count keeps them alive across runtimes (Workers). QuickJS calls
+// dup for every SharedArrayBuffer made from existing memory and free instead
+// of the free_func, so memory the pool doesn't know is left alone.
+static void *SharedAlloc(void *, const size_t size) {
+  return BufferPool::Get().Allocate(size, true);
+}
+static void SharedFree(void *, void *ptr) {
+  auto *buffer = static_cast<uint8_t *>(ptr);
+  if (BufferPool::Get().Owns(buffer))
+    BufferPool::Get().Release(buffer);
+}
+static void SharedDup(void *, void *ptr) {
+  auto *buffer = static_cast<uint8_t *>(ptr);
+  if (BufferPool::Get().Owns(buffer))
+    BufferPool::Get().Retain(buffer);
+}
+
+static JSRuntime *CreateRuntime(ContextHeap *heap) {
   static const JSMallocFunctions jsMallocFunctions = {
       Calloc, Malloc, Free, Realloc, mi_malloc_usable_size};
-  return JS_NewRuntime2(&jsMallocFunctions, nullptr);
+  static const JSSharedArrayBufferFunctions sharedBuffers = {
+      SharedAlloc, SharedFree, SharedDup, nullptr};
+  JSRuntime *rt = JS_NewRuntime2(&jsMallocFunctions, heap);
+  if (rt)
+    JS_SetSharedArrayBufferFunctions(rt, &sharedBuffers);
+  return rt;
 }
 
 static JSContext *CreateContext(JSRuntime *rt) {
@@ -37,14 +196,26 @@ static JSContext *CreateContext(JSRuntime *rt) {
   return ctx;
 }
 
-Context::Context(Instance *instance)
-    : Rt(CreateRuntime()),
+Context::Context(Instance *instance, const bool privateHeap)
+    : Heap(CreateHeap(privateHeap)) {
+  Rt = CreateRuntime(Heap);
+  Ctx = CreateContext(Rt);
+  Count = new std::atomic<int>(1);
+  RtCount = new std::atomic<int>(1);
+  JS_SetContextOpaque(Ctx, instance);
+}
+Context::Context(Instance *instance, const Context &other)
+    : Rt(other.Rt),
       Ctx(CreateContext(Rt)),
-      Count(new int(1)) {
+      Count(new std::atomic<int>(1)),
+      RtCount(other.RtCount),
+      Heap(other.Heap) {
+  RtCount->fetch_add(1, std::memory_order_relaxed);
   JS_SetContextOpaque(Ctx, instance);
 }
-Context::Context(const Context &o) : Rt(o.Rt), Ctx(o.Ctx), Count(o.Count) {
-  ++(*Count);
+Context::Context(const Context &o)
+    : Rt(o.Rt), Ctx(o.Ctx), Count(o.Count), RtCount(o.RtCount), Heap(o.Heap) {
+  Count->fetch_add(1, std::memory_order_relaxed);
 }
 
 Context &Context::operator=(const Context &other) noexcept {
@@ -57,27 +228,95 @@ Context &Context::operator=(const Context &other) noexcept {
   if (Count) {
     Release();
   }
-  ++(*other.Count);
+  other.Count->fetch_add(1, std::memory_order_relaxed);
   Count = other.Count;
+  RtCount = other.RtCount;
+  Heap = other.Heap;
   Ctx = other.Ctx;
   Rt = other.Rt;
   return *this;
 }
 
 void Context::Release() const {
-  --(*Count);
-  if (*Count <= 0) {
+  // atomic since a Context can move to another thread together with its
+  // Instance (Scheduler). The last one frees the runtime, that still has to
+  // happen on the thread using it.
+  if (Count->fetch_sub(1, std::memory_order_acq_rel) == 1) {
     delete Count;
     // raise(SIGTRAP);
     JS_FreeContext(Ctx);
-    JS_FreeRuntime(Rt);
+    if (RtCount->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete RtCount;
+      JS_FreeRuntime(Rt);
+      DestroyHeap(Heap);
+    }
   }
 }
+
+void Context::PrintStats() const {
+  if (!Rt)
+    return;
+  JSMemoryUsage usage;
+  JS_ComputeMemoryUsage(Rt, &usage);
+  JS_DumpMemoryUsage(stdout, &usage, Rt);
+}
+
+MemoryStats Context::GetMemoryStats() const {
+  MemoryStats stats{};
+  if (!Rt)
+    return stats;
+  JSMemoryUsage u;
+  JS_ComputeMemoryUsage(Rt, &u);
+  stats.Limit = u.malloc_limit;
+  stats.Malloc = {u.malloc_count, u.malloc_size};
+  stats.Used = {u.memory_used_count, u.memory_used_size};
+  stats.Atoms = {u.atom_count, u.atom_size};
+  stats.Strings = {u.str_count, u.str_size};
+  stats.Objects = {u.obj_count, u.obj_size};
+  stats.Properties = {u.prop_count, u.prop_size};
+  stats.Shapes = {u.shape_count, u.shape_size};
+  stats.Functions = {u.js_func_count, u.js_func_size};
+  stats.Bytecode = u.js_func_code_size;
+  stats.CFunctions = u.c_func_count;
+  stats.Arrays = u.array_count;
+  stats.FastArrays = u.fast_array_count;
+  stats.FastArrayElements = u.fast_array_elements;
+  stats.ArrayBuffers = {u.binary_object_count, u.binary_object_size};
+  stats.Heap = GetHeapStats();
+  return stats;
+}
+
+HeapStats Context::GetHeapStats() const {
+  if (!Heap)
+    return {};
+  return {Heap->Live.load(std::memory_order_relaxed),
+          Heap->Peak.load(std::memory_order_relaxed),
+          Heap->Count.load(std::memory_order_relaxed),
+          Heap->Total.load(std::memory_order_relaxed)};
+}
+uint32_t Context::GetClassID(const void *key) const {
+  if (!Heap)
+    return 0;
+  const auto it = Heap->Classes.find(key);
+  return it == Heap->Classes.end() ? 0 : it->second.first;
+}
+
+void Context::SetClassID(const void *key, const uint32_t id,
+                         Ref<void> owner) const {
+  if (Heap)
+    Heap->Classes[key] = {id, std::move(owner)};
+}
+
 Context::~Context() { Release(); }
 // To avoid Deallocating the last instance for a Free Empty Context Constructor
 // :)
-static int StaticCount = 1;
-Context::Context() : Rt(nullptr), Ctx(nullptr), Count(&StaticCount) {
-  ++StaticCount;
+static std::atomic<int> StaticCount = 1;
+Context::Context()
+    : Rt(nullptr),
+      Ctx(nullptr),
+      Count(&StaticCount),
+      RtCount(&StaticCount),
+      Heap(nullptr) {
+  StaticCount.fetch_add(1, std::memory_order_relaxed);
 }
 } // namespace VQJS
\ No newline at end of file
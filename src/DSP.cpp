@@ -0,0 +1,519 @@
+#include "DSP.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <quickjs/quickjs.h>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace VQJS::DSP {
+static constexpr double Pi = 3.14159265358979323846;
+
+// Smallest possible vector abstraction, the kernels are written against it
+// and a scalar tail handles the rest.
+#if defined(__AVX2__)
+struct Vec {
+  static constexpr size_t Width = 4;
+  __m256d V;
+  static Vec Load(const double *p) { return {_mm256_loadu_pd(p)}; }
+  static Vec Set(const double v) { return {_mm256_set1_pd(v)}; }
+  void Store(double *p) const { _mm256_storeu_pd(p, V); }
+  friend Vec operator+(Vec a, Vec b) { return {_mm256_add_pd(a.V, b.V)}; }
+  friend Vec operator-(Vec a, Vec b) { return {_mm256_sub_pd(a.V, b.V)}; }
+  friend Vec operator*(Vec a, Vec b) { return {_mm256_mul_pd(a.V, b.V)}; }
+  static Vec Max(Vec a, Vec b) { return {_mm256_max_pd(a.V, b.V)}; }
+  [[nodiscard]] Vec Abs() const {
+    return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), V)};
+  }
+  [[nodiscard]] double HSum() const {
+    const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(V),
+                                   _mm256_extractf128_pd(V, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+  }
+  [[nodiscard]] double HMax() const {
+    const __m128d max = _mm_max_pd(_mm256_castpd256_pd128(V),
+                                   _mm256_extractf128_pd(V, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(max, _mm_unpackhi_pd(max, max)));
+  }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Vec {
+  static constexpr size_t Width = 2;
+  __m128d V;
+  static Vec Load(const double *p) { return {_mm_loadu_pd(p)}; }
+  static Vec Set(const double v) { return {_mm_set1_pd(v)}; }
+  void Store(double *p) const { _mm_storeu_pd(p, V); }
+  friend Vec operator+(Vec a, Vec b) { return {_mm_add_pd(a.V, b.V)}; }
+  friend Vec operator-(Vec a, Vec b) { return {_mm_sub_pd(a.V, b.V)}; }
+  friend Vec operator*(Vec a, Vec b) { return {_mm_mul_pd(a.V, b.V)}; }
+  static Vec Max(Vec a, Vec b) { return {_mm_max_pd(a.V, b.V)}; }
+  [[nodiscard]] Vec Abs() const {
+    return {_mm_andnot_pd(_mm_set1_pd(-0.0), V)};
+  }
+  [[nodiscard]] double HSum() const {
+    return _mm_cvtsd_f64(_mm_add_sd(V, _mm_unpackhi_pd(V, V)));
+  }
+  [[nodiscard]] double HMax() const {
+    return _mm_cvtsd_f64(_mm_max_sd(V, _mm_unpackhi_pd(V, V)));
+  }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct Vec {
+  static constexpr size_t Width = 2;
+  float64x2_t V;
+  static Vec Load(const double *p) { return {vld1q_f64(p)}; }
+  static Vec Set(const double v) { return {vdupq_n_f64(v)}; }
+  void Store(double *p) const { vst1q_f64(p, V); }
+  friend Vec operator+(Vec a, Vec b) { return {vaddq_f64(a.V, b.V)}; }
+  friend Vec operator-(Vec a, Vec b) { return {vsubq_f64(a.V, b.V)}; }
+  friend Vec operator*(Vec a, Vec b) { return {vmulq_f64(a.V, b.V)}; }
+  static Vec Max(Vec a, Vec b) { return {vmaxq_f64(a.V, b.V)}; }
+  [[nodiscard]] Vec Abs() const { return {vabsq_f64(V)}; }
+  [[nodiscard]] double HSum() const { return vaddvq_f64(V); }
+  [[nodiscard]] double HMax() const { return vmaxvq_f64(V); }
+};
+#else
+struct Vec {
+  static constexpr size_t Width = 1;
+  double V;
+  static Vec Load(const double *p) { return {*p}; }
+  static Vec Set(const double v) { return {v}; }
+  void Store(double *p) const { *p = V; }
+  friend Vec operator+(Vec a, Vec b) { return {a.V + b.V}; }
+  friend Vec operator-(Vec a, Vec b) { return {a.V - b.V}; }
+  friend Vec operator*(Vec a, Vec b) { return {a.V * b.V}; }
+  static Vec Max(Vec a, Vec b) { return {a.V > b.V ? a.V : b.V}; }
+  [[nodiscard]] Vec Abs() const { return {std::fabs(V)}; }
+  [[nodiscard]] double HSum() const { return V; }
+  [[nodiscard]] double HMax() const { return V; }
+};
+#endif
+
+// Works for Vec and double, so one lambda covers the body and the tail
+template <typename Op>
+static void Map(double *out, const double *a, const double *b,
+                const size_t size, Op op) {
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    op(Vec::Load(a + i), Vec::Load(b + i)).Store(out + i);
+  }
+  for (; i < size; i++) {
+    out[i] = op(a[i], b[i]);
+  }
+}
+
+template <typename Op>
+static void Map(double *out, const double *a, const double b,
+                const size_t size, Op op) {
+  const Vec scalar = Vec::Set(b);
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    op(Vec::Load(a + i), scalar).Store(out + i);
+  }
+  for (; i < size; i++) {
+    out[i] = op(a[i], b);
+  }
+}
+
+static constexpr auto AddOp = [](auto x, auto y) { return x + y; };
+static constexpr auto MulOp = [](auto x, auto y) { return x * y; };
+
+double Sum(const double *a, const size_t size) {
+  Vec acc = Vec::Set(0.0);
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    acc = acc + Vec::Load(a + i);
+  }
+  double sum = acc.HSum();
+  for (; i < size; i++) {
+    sum += a[i];
+  }
+  return sum;
+}
+
+double Rms(const double *a, const size_t size) {
+  if (size == 0)
+    return 0.0;
+  Vec acc = Vec::Set(0.0);
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    const Vec v = Vec::Load(a + i);
+    acc = acc + v * v;
+  }
+  double sum = acc.HSum();
+  for (; i < size; i++) {
+    sum += a[i] * a[i];
+  }
+  return std::sqrt(sum / static_cast<double>(size));
+}
+
+double Peak(const double *a, const size_t size) {
+  Vec acc = Vec::Set(0.0);
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    acc = Vec::Max(acc, Vec::Load(a + i).Abs());
+  }
+  double peak = acc.HMax();
+  for (; i < size; i++) {
+    peak = std::max(peak, std::fabs(a[i]));
+  }
+  return peak;
+}
+
+void Add(double *out, const double *a, const double *b, const size_t size) {
+  Map(out, a, b, size, AddOp);
+}
+void Add(double *out, const double *a, const double b, const size_t size) {
+  Map(out, a, b, size, AddOp);
+}
+void Mul(double *out, const double *a, const double *b, const size_t size) {
+  Map(out, a, b, size, MulOp);
+}
+void Mul(double *out, const double *a, const double b, const size_t size) {
+  Map(out, a, b, size, MulOp);
+}
+
+void Mix(double *out, const double *a, const double *b, const double t,
+         const size_t size) {
+  const Vec factor = Vec::Set(t);
+  size_t i = 0;
+  for (; i + Vec::Width <= size; i += Vec::Width) {
+    const Vec x = Vec::Load(a + i);
+    (x + (Vec::Load(b + i) - x) * factor).Store(out + i);
+  }
+  for (; i < size; i++) {
+    out[i] = a[i] + (b[i] - a[i]) * t;
+  }
+}
+
+// Tables are built per size and scripts can ask for any size, so only the
+// most recently used ones are kept. Callers hold on to theirs while another
+// thread evicts it.
+template <typename Key, typename T> struct TableCache {
+  static constexpr size_t MaxEntries = 16;
+
+  template <typename Build>
+  std::shared_ptr<const T> Get(const Key &key, Build build) {
+    std::lock_guard lock(m_Mutex);
+    for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it) {
+      if (it->first == key) {
+        m_Entries.splice(m_Entries.begin(), m_Entries, it);
+        return it->second;
+      }
+    }
+    auto table = std::make_shared<const T>(build());
+    m_Entries.emplace_front(key, table);
+    if (m_Entries.size() > MaxEntries)
+      m_Entries.pop_back();
+    return table;
+  }
+
+private:
+  std::mutex m_Mutex;
+  std::list<std::pair<Key, std::shared_ptr<const T>>> m_Entries;
+};
+
+static std::shared_ptr<const std::vector<double>>
+GetWindow(const Window window, const size_t size) {
+  static TableCache<std::pair<Window, size_t>, std::vector<double>> windows;
+  return windows.Get({window, size}, [&] {
+    std::vector<double> table(size, 1.0);
+    const double n = static_cast<double>(size - 1);
+    for (size_t i = 0; size > 1 && i < size; i++) {
+      const double x = 2.0 * Pi * static_cast<double>(i) / n;
+      switch (window) {
+      case Window::Hann: table[i] = 0.5 - 0.5 * std::cos(x); break;
+      case Window::Hamming: table[i] = 0.54 - 0.46 * std::cos(x); break;
+      case Window::Blackman:
+        table[i] = 0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2.0 * x);
+        break;
+      }
+    }
+    return table;
+  });
+}
+
+void ApplyWindow(double *a, const size_t size, const Window window) {
+  Mul(a, a, GetWindow(window, size)->data(), size);
+}
+
+// A real FFT of size N is done as a complex FFT of size N / 2 on the
+// even/odd packed input plus a split step. Plans are cached per size, see
+// TableCache.
+using Complex = std::complex<double>;
+
+static Complex CMul(const Complex a, const Complex b) {
+  return {a.real() * b.real() - a.imag() * b.imag(),
+          a.real() * b.imag() + a.imag() * b.real()};
+}
+
+struct FFTPlan {
+  size_t Half{0};
+  std::vector<uint32_t> Reverse;
+  std::vector<Complex> Twiddles;
+  std::vector<Complex> Split;
+};
+
+static FFTPlan BuildPlan(const size_t size) {
+  FFTPlan plan;
+  const size_t half = size / 2;
+  const int bits = std::countr_zero(half);
+  plan.Half = half;
+  plan.Reverse.resize(half);
+  for (size_t i = 0; i < half; i++) {
+    uint32_t reversed = 0;
+    for (int b = 0; b < bits; b++) {
+      reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+    }
+    plan.Reverse[i] = reversed;
+  }
+  plan.Twiddles.resize(half / 2);
+  for (size_t i = 0; i < half / 2; i++) {
+    plan.Twiddles[i] = std::polar(1.0, -2.0 * Pi * static_cast<double>(i) /
+                                           static_cast<double>(half));
+  }
+  plan.Split.resize(half + 1);
+  for (size_t i = 0; i <= half; i++) {
+    plan.Split[i] = std::polar(1.0, -2.0 * Pi * static_cast<double>(i) /
+                                        static_cast<double>(size));
+  }
+  return plan;
+}
+
+static std::shared_ptr<const FFTPlan> GetPlan(const size_t size) {
+  static TableCache<size_t, FFTPlan> plans;
+  return plans.Get(size, [size] { return BuildPlan(size); });
+}
+
+bool RealFFT(const double *in, const size_t size, double *re, double *im) {
+  if (size < 2 || !std::has_single_bit(size))
+    return false;
+  const auto cached = GetPlan(size);
+  const FFTPlan &plan = *cached;
+  const size_t half = plan.Half;
+  thread_local std::vector<Complex> work;
+  work.resize(half);
+  for (size_t i = 0; i < half; i++) {
+    work[plan.Reverse[i]] = {in[2 * i], in[2 * i + 1]};
+  }
+
+  for (size_t length = 2; length <= half; length <<= 1) {
+    const size_t step = half / length;
+    const size_t middle = length / 2;
+    for (size_t i = 0; i < half; i += length) {
+      for (size_t j = 0; j < middle; j++) {
+        const Complex u = work[i + j];
+        const Complex v = CMul(work[i + j + middle], plan.Twiddles[j * step]);
+        work[i + j] = u + v;
+        work[i + j + middle] = u - v;
+      }
+    }
+  }
+
+  for (size_t k = 0; k <= half; k++) {
+    const Complex z = work[k % half];
+    const Complex mirrored = std::conj(work[(half - k) % half]);
+    const Complex even = (z + mirrored) * 0.5;
+    const Complex odd = CMul(z - mirrored, {0.0, -0.5});
+    const Complex x = even + CMul(plan.Split[k], odd);
+    re[k] = x.real();
+    im[k] = x.imag();
+  }
+  return true;
+}
+
+bool Spectrum(const double *in, const size_t size, double *magnitudes) {
+  thread_local std::vector<double> re, im;
+  re.resize(size / 2 + 1);
+  im.resize(size / 2 + 1);
+  if (!RealFFT(in, size, re.data(), im.data()))
+    return false;
+  for (size_t i = 0; i < re.size(); i++) {
+    magnitudes[i] = std::sqrt(re[i] * re[i] + im[i] * im[i]);
+  }
+  return true;
+}
+
+// JS bindings, they work on the typed array memory directly
+struct Span {
+  double *Data{nullptr};
+  size_t Size{0};
+};
+
+static bool ToSpan(JSContext *ctx, JSValueConst value, Span &span) {
+  size_t byteOffset = 0;
+  size_t byteLength = 0;
+  size_t bytesPerElement = 0;
+  const JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &byteOffset,
+                                                &byteLength, &bytesPerElement);
+  if (JS_IsException(buffer))
+    return false;
+  size_t size = 0;
+  uint8_t *data = JS_GetArrayBuffer(ctx, &size, buffer);
+  JS_FreeValue(ctx, buffer);
+  if (!data)
+    return false;
+  if (bytesPerElement != sizeof(double)) {
+    JS_ThrowTypeError(ctx, "Float64Array expected");
+    return false;
+  }
+  span = {reinterpret_cast<double *>(data + byteOffset),
+          byteLength / sizeof(double)};
+  return true;
+}
+
+#define SPAN(name, index)                                                      \
+  Span name;                                                                   \
+  if (!ToSpan(ctx, argv[index], name))                                         \
+    return JS_EXCEPTION;
+
+static JSValue JsSum(JSContext *ctx, JSValueConst, int, JSValueConst *argv) {
+  SPAN(a, 0)
+  return JS_NewFloat64(ctx, Sum(a.Data, a.Size));
+}
+
+static JSValue JsRms(JSContext *ctx, JSValueConst, int, JSValueConst *argv) {
+  SPAN(a, 0)
+  return JS_NewFloat64(ctx, Rms(a.Data, a.Size));
+}
+
+static JSValue JsPeak(JSContext *ctx, JSValueConst, int, JSValueConst *argv) {
+  SPAN(a, 0)
+  return JS_NewFloat64(ctx, Peak(a.Data, a.Size));
+}
+
+// out, a, b where b can be a number as well
+template <auto ArrayOp, auto ScalarOp>
+static JSValue JsBinary(JSContext *ctx, JSValueConst, int,
+                        JSValueConst *argv) {
+  SPAN(out, 0)
+  SPAN(a, 1)
+  if (JS_IsNumber(argv[2])) {
+    double b;
+    JS_ToFloat64(ctx, &b, argv[2]);
+    ScalarOp(out.Data, a.Data, b, std::min(out.Size, a.Size));
+    return JS_UNDEFINED;
+  }
+  SPAN(b, 2)
+  ArrayOp(out.Data, a.Data, b.Data, std::min({out.Size, a.Size, b.Size}));
+  return JS_UNDEFINED;
+}
+
+static JSValue JsMix(JSContext *ctx, JSValueConst, int, JSValueConst *argv) {
+  SPAN(out, 0)
+  SPAN(a, 1)
+  SPAN(b, 2)
+  double t;
+  if (JS_ToFloat64(ctx, &t, argv[3]))
+    return JS_EXCEPTION;
+  Mix(out.Data, a.Data, b.Data, t, std::min({out.Size, a.Size, b.Size}));
+  return JS_UNDEFINED;
+}
+
+static JSValue JsWindow(JSContext *ctx, JSValueConst, int,
+                        JSValueConst *argv) {
+  SPAN(a, 0)
+  Window window = Window::Hann;
+  if (JS_IsString(argv[1])) {
+    const char *str = JS_ToCString(ctx, argv[1]);
+    const std::string_view name = str ? str : "";
+    if (name == "hamming")
+      window = Window::Hamming;
+    else if (name == "blackman")
+      window = Window::Blackman;
+    else if (name != "hann") {
+      JS_FreeCString(ctx, str);
+      return JS_ThrowRangeError(ctx, "unknown window");
+    }
+    JS_FreeCString(ctx, str);
+  }
+  ApplyWindow(a.Data, a.Size, window);
+  return JS_UNDEFINED;
+}
+
+static JSValue JsFFT(JSContext *ctx, JSValueConst, int, JSValueConst *argv) {
+  SPAN(in, 0)
+  SPAN(re, 1)
+  SPAN(im, 2)
+  if (re.Size < in.Size / 2 + 1 || im.Size < in.Size / 2 + 1)
+    return JS_ThrowRangeError(ctx, "output needs size / 2 + 1 bins");
+  if (!RealFFT(in.Data, in.Size, re.Data, im.Data))
+    return JS_ThrowRangeError(ctx, "size has to be a power of two");
+  return JS_UNDEFINED;
+}
+
+static JSValue JsSpectrum(JSContext *ctx, JSValueConst, int,
+                          JSValueConst *argv) {
+  SPAN(in, 0)
+  SPAN(out, 1)
+  if (out.Size < in.Size / 2 + 1)
+    return JS_ThrowRangeError(ctx, "output needs size / 2 + 1 bins");
+  if (!Spectrum(in.Data, in.Size, out.Data))
+    return JS_ThrowRangeError(ctx, "size has to be a power of two");
+  return JS_UNDEFINED;
+}
+
+#undef SPAN
+
+struct Export {
+  const char *Name;
+  JSCFunction *Function;
+  int Length;
+};
+
+static constexpr void (*AddArray)(double *, const double *, const double *,
+                                  size_t) = &Add;
+static constexpr void (*AddScalar)(double *, const double *, double,
+                                   size_t) = &Add;
+static constexpr void (*MulArray)(double *, const double *, const double *,
+                                  size_t) = &Mul;
+static constexpr void (*MulScalar)(double *, const double *, double,
+                                   size_t) = &Mul;
+
+static const Export Exports[] = {
+    {"sum", &JsSum, 1},
+    {"rms", &JsRms, 1},
+    {"peak", &JsPeak, 1},
+    {"add", &JsBinary<AddArray, AddScalar>, 3},
+    {"mul", &JsBinary<MulArray, MulScalar>, 3},
+    {"mix", &JsMix, 4},
+    {"window", &JsWindow, 2},
+    {"fft", &JsFFT, 3},
+    {"spectrum", &JsSpectrum, 2},
+};
+
+static int InitModule(JSContext *ctx, JSModuleDef *m) {
+  for (const auto &item : Exports) {
+    JS_SetModuleExport(
+        ctx, m, item.Name,
+        JS_NewCFunction(ctx, item.Function, item.Name, item.Length));
+  }
+  return 0;
+}
+
+JSModuleDef *CreateModule(JSContext *ctx, const char *name) {
+  JSModuleDef *m = JS_NewCModule(ctx, name, &InitModule);
+  if (!m)
+    return nullptr;
+  for (const auto &item : Exports) {
+    JS_AddModuleExport(ctx, m, item.Name);
+  }
+  return m;
+}
+} // namespace VQJS::DSP
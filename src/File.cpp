@@ -1,7 +1,11 @@
 #include "File.h"
 
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace VQJS {
 bool File::Exists(const std::string &file) {
@@ -43,4 +47,33 @@ bool File::CreateDirectory(const std::string &file) {
   return create_directories(std::filesystem::path(file));
 }
 
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &file) {
+  Close();
+  const int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file alive
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  m_Data = static_cast<const uint8_t *>(data);
+  m_Size = info.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_Data)
+    munmap(const_cast<uint8_t *>(m_Data), m_Size);
+  m_Data = nullptr;
+  m_Size = 0;
+}
+
 } // namespace VQJS
\ No newline at end of file
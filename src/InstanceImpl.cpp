@@ -1,9 +1,16 @@
 #include "impl.h"
 #include "vqjs.h"
 
+#include <Bundle.h>
 #include <File.h>
+#include <Recorder.h>
+#include <Worker.h>
+#include <algorithm>
+#include <cstdint>
 #include <quickjs/quickjs-libc.h>
 #include <quickjs/quickjs.h>
+#include <ranges>
+#include <span>
 #include <string>
 #include <utility>
 
@@ -63,6 +70,35 @@ static JSValue EvalFile(JSContext *ctx, const std::string &filename, int module,
   return ret;
 }
 
+// Modules compiled by Runtime::WriteBundle
+static JSValue EvalBytecode(JSContext *ctx, const std::span<const uint8_t> code,
+                            const bool eval) {
+  auto *runtime =
+      static_cast<Runtime *>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+  JSValue val =
+      JS_ReadObject(ctx, code.data(), code.size(), JS_READ_OBJ_BYTECODE);
+  if (!JS_IsException(val) && JS_IsModule(val)) {
+    js_module_set_import_meta(ctx, val, 0, eval);
+    // the loader resolves the imports itself
+    if (!eval)
+      return val;
+    if (JS_ResolveModule(ctx, val) < 0) {
+      JS_FreeValue(ctx, val);
+      val = JS_EXCEPTION;
+    }
+  }
+  if (!JS_IsException(val))
+    val = JS_EvalFunction(ctx, val);
+  if (JS_IsException(val)) {
+    val = JS_GetException(ctx);
+    auto *instance = static_cast<Instance *>(JS_GetContextOpaque(ctx));
+    const Value error{instance->GetContext(), FROM(JS_DupValue(ctx, val))};
+    runtime->GetLogger().Error(error.AsString());
+    runtime->GetLogger().Error(error.ExceptionStack());
+  }
+  return val;
+}
+
 static int ModuleTypeToNumber(ModuleType type) {
   switch (type) {
   case ModuleType::Global: return 0;
@@ -75,14 +111,37 @@ static int ModuleTypeToNumber(ModuleType type) {
 Value Instance::LoadFile(const std::string &file, ModuleType type,
                          bool eval) const {
   std::string realFile = file[0] == '@' ? file : m_BaseDirectory + file;
-  return Value(m_Context, FROM(EvalFile(m_Context, realFile,
-                                        ModuleTypeToNumber(type), eval)));
+  const auto *runtime =
+      static_cast<Runtime *>(JS_GetRuntimeOpaque(JS_GetRuntime(m_Context)));
+  if (runtime && runtime->m_Bundle) {
+    if (const auto code = runtime->m_Bundle->Find(realFile); !code.empty())
+      return Value(m_Context, FROM(EvalBytecode(m_Context, code, eval)));
+  }
+  const JSValue val =
+      EvalFile(m_Context, realFile, ModuleTypeToNumber(type), eval);
+  if (runtime && runtime->m_Recording && !eval && JS_IsModule(val)) {
+    // the Runtime strip config applies to the compile already, this
+    // covers modules compiled before it was set
+    const int strip = JS_GetStripInfo(m_Context);
+    int flags = JS_WRITE_OBJ_BYTECODE;
+    if (strip & JS_STRIP_SOURCE)
+      flags |= JS_WRITE_OBJ_STRIP_SOURCE;
+    if (strip & JS_STRIP_DEBUG)
+      flags |= JS_WRITE_OBJ_STRIP_DEBUG;
+    size_t size = 0;
+    uint8_t *code = JS_WriteObject(m_Context, &size, val, flags);
+    if (code) {
+      runtime->m_Recording->Add(realFile, code, size);
+      js_free(m_Context, code);
+    }
+  }
+  return Value(m_Context, FROM(val));
 }
 Value Instance::Global() const {
   return Value(m_Context, FROM(JS_GetGlobalObject(m_Context)));
 }
-Value Instance::String(const std::string &data) const {
-  JSValue val = JS_NewString(m_Context, data.c_str());
+Value Instance::String(const std::string_view data) const {
+  JSValue val = JS_NewStringLen(m_Context, data.data(), data.size());
   return Value(m_Context, FROM(val));
 }
 Value Instance::Double(double data) const {
@@ -108,17 +167,198 @@ void Instance::SetStackSize(int64_t size) {
   JS_SetMaxStackSize(m_Context, size);
 }
 
-Instance::Instance(std::string name)
+Instance::Instance(std::string name, const bool privateHeap)
     : m_Name(std::move(name)),
-      m_Context(this) {
+      m_Context(this, privateHeap) {
   JS_SetContextOpaque(m_Context, this);
 }
 
-Instance::~Instance() = default;
+Instance::Instance(std::string name, const Instance &share)
+    : m_BaseDirectory(share.m_BaseDirectory),
+      m_Name(std::move(name)),
+      m_Context(this, share.m_Context),
+      m_SharedRuntime(true),
+      m_Owner(share.m_Owner) {}
+
+Instance::~Instance() {
+  TerminateWorkers();
+  ReleaseShapes();
+}
 
 void Instance::Reset() {
-  const Context ctx{this};
+  TerminateWorkers();
+  ReleaseShapes();
+  ClearScripts();
+  // shared ones stay on their runtime, the others get a fresh one
+  const Context ctx =
+      m_SharedRuntime ? Context{this, m_Context} : Context{this};
   m_Context = ctx;
+  m_Classes.clear();
+  ApplyMemoryConfig();
+}
+
+void Instance::Swap(Instance &other) {
+  const Context context = m_Context;
+  m_Context = other.m_Context;
+  other.m_Context = context;
+  std::swap(m_SharedRuntime, other.m_SharedRuntime);
+  m_Functions.swap(other.m_Functions);
+  m_Classes.swap(other.m_Classes);
+  m_Shapes.swap(other.m_Shapes);
+  m_Workers.swap(other.m_Workers);
+  // list iterators stay valid across the swap
+  m_ScriptOrder.swap(other.m_ScriptOrder);
+  m_Scripts.swap(other.m_Scripts);
+  JS_SetContextOpaque(m_Context, this);
+  JS_SetContextOpaque(other.m_Context, &other);
+  ApplyMemoryConfig();
+}
+
+Value Instance::SnapshotState(const Value &state, Message &out) const {
+  // nothing to transfer, the old runtime goes away anyway
+  return Message::Write(state, state.Undefined(), out);
+}
+
+Value Instance::RestoreState(const Message &snapshot) const {
+  return snapshot.Read(Global());
+}
+
+void Instance::SetRecorder(Ref<Recorder> recorder) {
+  if (m_Recorder)
+    m_Recorder->Flush();
+  m_Recorder = std::move(recorder);
+}
+
+size_t Instance::Poll() {
+  // handlers can create or terminate workers, so they only run on copies
+  const auto workers = m_Workers;
+  size_t count = 0;
+  for (const auto &worker : workers)
+    count += worker->Dispatch();
+  std::vector<Ref<Worker>> finished{};
+  std::erase_if(m_Workers, [&finished](const Ref<Worker> &worker) {
+    if (worker->IsRunning())
+      return false;
+    finished.push_back(worker);
+    return true;
+  });
+  for (const auto &worker : finished) {
+    // joined, so nothing gets posted after the last dispatch
+    worker->Join();
+    count += worker->Dispatch();
+    worker->Terminate();
+  }
+  return count;
+}
+
+void Instance::TerminateWorkers() {
+  for (const auto &worker : m_Workers)
+    worker->Terminate();
+  m_Workers.clear();
+}
+
+void Instance::ReleaseShapes() {
+  for (const auto &atoms : m_Shapes | std::views::values) {
+    for (const auto atom : atoms)
+      JS_FreeAtom(m_Context, atom);
+  }
+  m_Shapes.clear();
+}
+
+// FNV-1a over name and source, collisions are checked on lookup
+static uint64_t HashScript(const std::string_view name,
+                           const std::string_view source) {
+  uint64_t hash = 14695981039346656037ull;
+  const auto feed = [&hash](const std::string_view data) {
+    for (const char c : data) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+  };
+  feed(name);
+  hash ^= 0xFF;
+  hash *= 1099511628211ull;
+  feed(source);
+  return hash;
+}
+
+Value Script::Run() const {
+  // default constructed, there's no Context to throw on
+  if (!m_Function.m_Context)
+    return Value{};
+  // the compile error is still on the Context
+  if (m_Function.IsException())
+    return m_Function;
+  JSContext *ctx = m_Function.m_Context;
+  // EvalFunction takes the ownership, the bytecode stays in the cache
+  return Value(m_Function.m_Context,
+               FROM(JS_EvalFunction(
+                   ctx, JS_DupValue(ctx, TO(m_Function.m_UnderlyingValue)))));
+}
+
+bool Script::IsValid() const {
+  return m_Function.m_Context && !m_Function.IsException();
+}
+
+Script Instance::Compile(const std::string_view source,
+                         const std::string &name) {
+  const uint64_t hash = HashScript(name, source);
+  if (const auto it = m_Scripts.find(hash); it != m_Scripts.end()) {
+    const auto entry = it->second;
+    if (entry->Source == source && entry->Name == name) {
+      m_ScriptOrder.splice(m_ScriptOrder.begin(), m_ScriptOrder, entry);
+      m_ScriptStats.Hits++;
+      return entry->Compiled;
+    }
+    m_ScriptOrder.erase(entry);
+    m_Scripts.erase(it);
+  }
+
+  // the parser needs a null terminated buffer
+  std::string code{source};
+  const JSValue function =
+      JS_Eval(m_Context, code.c_str(), code.size(), name.c_str(),
+              JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+  Script script{Value(m_Context, FROM(function))};
+  m_ScriptStats.Misses++;
+  if (!script.IsValid() || m_ScriptCacheSize == 0)
+    return script;
+
+  m_ScriptOrder.push_front({hash, std::move(code), name, script});
+  m_Scripts[hash] = m_ScriptOrder.begin();
+  TrimScripts();
+  return script;
+}
+
+Value Instance::Eval(const std::string_view source, const std::string &name) {
+  const auto script = Compile(source, name);
+  if (!script.IsValid())
+    return Value(m_Context, FROM(JS_EXCEPTION));
+  return script.Run();
+}
+
+void Instance::SetScriptCacheSize(const size_t size) {
+  m_ScriptCacheSize = size;
+  TrimScripts();
+}
+
+ScriptCacheStats Instance::GetScriptCacheStats() const {
+  ScriptCacheStats stats = m_ScriptStats;
+  stats.Size = m_ScriptOrder.size();
+  return stats;
+}
+
+void Instance::TrimScripts() {
+  while (m_ScriptOrder.size() > m_ScriptCacheSize) {
+    m_Scripts.erase(m_ScriptOrder.back().Hash);
+    m_ScriptOrder.pop_back();
+    m_ScriptStats.Evictions++;
+  }
+}
+
+void Instance::ClearScripts() {
+  m_Scripts.clear();
+  m_ScriptOrder.clear();
 }
 
 void Instance::SetBaseDirectory(const std::string &directory) {
@@ -126,6 +366,123 @@ void Instance::SetBaseDirectory(const std::string &directory) {
 }
 Context &Instance::GetContext() { return m_Context; }
 
+HeapStats Instance::GetHeapStats() const { return m_Context.GetHeapStats(); }
+
+MemoryStats Instance::GetMemoryStats() const {
+  return m_Context.GetMemoryStats();
+}
+
+void Instance::SetMemoryLimit(const size_t limit, MemoryCallback onExceeded,
+                              const float warnAt) {
+  m_Memory.Limit = limit;
+  m_Memory.WarnAt = warnAt;
+  m_Memory.Warned = false;
+  m_Memory.OnExceeded = std::move(onExceeded);
+  ApplyMemoryConfig();
+}
+
+void Instance::SetMetricsSink(MetricsSink sink,
+                              const std::chrono::milliseconds interval) {
+  m_Memory.Sink = std::move(sink);
+  m_Memory.Interval = interval;
+  ApplyMemoryConfig();
+}
+
+void Instance::SampleMemory() {
+  if (!m_Memory.Sink)
+    return;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - m_Memory.LastSample < m_Memory.Interval)
+    return;
+  m_Memory.LastSample = now;
+  m_Memory.Sink(*this, GetMemoryStats());
+}
+
+void Instance::ApplyMemoryConfig() {
+  // limit and interrupt handler are per runtime, a shared instance would
+  // replace what the owner set up
+  if (!m_SharedRuntime) {
+    JS_SetMemoryLimit(m_Context, m_Memory.Limit);
+    if (m_Memory.OnExceeded || m_Memory.Sink)
+      JS_SetInterruptHandler(m_Context, &Instance::OnInterrupt, this);
+    else
+      JS_SetInterruptHandler(m_Context, nullptr, nullptr);
+  }
+  if (m_GC.InFrame)
+    BeginFrame();
+}
+
+void Instance::SetGCPolicy(GCPolicy policy) {
+  m_GCPolicy = std::move(policy);
+  if (m_GC.InFrame)
+    BeginFrame();
+}
+
+void Instance::BeginFrame() {
+  if (!m_GC.InFrame && m_Recorder)
+    m_Recorder->Frame();
+  m_GC.InFrame = true;
+  const size_t threshold = m_GCPolicy.FrameThreshold;
+  JS_SetGCThreshold(m_Context, threshold ? threshold : SIZE_MAX);
+}
+
+void Instance::EndFrame() {
+  if (!m_GC.InFrame)
+    return;
+  m_GC.InFrame = false;
+  // same as quickjs sets after an automatic collection. A value saved in
+  // BeginFrame could be stale by now, e.g. another instance on the runtime
+  // saved our SIZE_MAX
+  const size_t live = GetHeapStats().LiveBytes;
+  JS_SetGCThreshold(m_Context, std::max<size_t>(256 * 1024, live + live / 2));
+}
+
+bool Instance::Idle(const std::chrono::microseconds budget) {
+  const size_t before = GetHeapStats().LiveBytes;
+  // an automatic GC might have run in between
+  m_GC.LastLive = std::min(m_GC.LastLive, before);
+  if (before - m_GC.LastLive < m_GCPolicy.MinGrowth)
+    return false;
+  const double nsPerByte =
+      m_GC.NsPerByte == 0 ? m_GCPolicy.InitialNsPerByte : m_GC.NsPerByte;
+  const auto estimate = std::chrono::nanoseconds(
+      static_cast<int64_t>(nsPerByte * static_cast<double>(before)));
+  if (estimate > budget)
+    return false;
+
+  const auto start = std::chrono::steady_clock::now();
+  JS_RunGC(m_Context);
+  const GCEvent event{std::chrono::steady_clock::now() - start, before,
+                      GetHeapStats().LiveBytes};
+  m_GC.LastLive = event.After;
+  const double rate = static_cast<double>(event.Pause.count()) /
+                      static_cast<double>(std::max<size_t>(before, 1));
+  m_GC.NsPerByte =
+      m_GC.NsPerByte == 0 ? rate : m_GC.NsPerByte * 0.8 + rate * 0.2;
+  if (m_GCPolicy.OnCollect)
+    m_GCPolicy.OnCollect(*this, event);
+  return true;
+}
+
+// QuickJS calls this every few thousand instructions
+int Instance::OnInterrupt(JSRuntime *, void *opaque) {
+  auto *instance = static_cast<Instance *>(opaque);
+  auto &memory = instance->m_Memory;
+  instance->SampleMemory();
+  if (!memory.OnExceeded || memory.Limit == 0)
+    return 0;
+  const auto warn = static_cast<size_t>(
+      static_cast<double>(memory.Limit) * memory.WarnAt);
+  if (instance->GetHeapStats().LiveBytes < warn) {
+    memory.Warned = false;
+    return 0;
+  }
+  if (memory.Warned)
+    return 0;
+  memory.Warned = true;
+  return memory.OnExceeded(*instance, instance->GetMemoryStats()) ? 1 : 0;
+}
+
 #undef FROM
 #undef TO
 
@@ -0,0 +1,885 @@
+#include "Json.h"
+#include "impl.h"
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <quickjs/quickjs.h>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+static constexpr uint32_t MaxDepth = 512;
+
+static bool IsSpace(const char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// 16 bytes at a time, returns the first byte that is not whitespace
+static const char *SkipSpace(const char *p, const char *end) {
+  // most of the time there is nothing or a single space to skip
+  if (p < end && !IsSpace(*p))
+    return p;
+#if defined(__SSE2__) || defined(_M_X64)
+  while (end - p >= 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i space =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))));
+    const auto mask = static_cast<uint32_t>(~_mm_movemask_epi8(space)) & 0xFFFF;
+    if (mask != 0)
+      return p + std::countr_zero(mask);
+    p += 16;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  while (end - p >= 16) {
+    const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    const uint8x16_t space =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                          vceqq_u8(v, vdupq_n_u8('\n'))),
+                 vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')),
+                          vceqq_u8(v, vdupq_n_u8('\t'))));
+    if (vminvq_u8(space) != 0xFF)
+      break;
+    p += 16;
+  }
+#endif
+  while (p < end && IsSpace(*p))
+    p++;
+  return p;
+}
+
+// First byte that ends the fast path of a string: quote, backslash or a
+// control character (which is invalid in JSON and needs escaping on output)
+static const char *ScanString(const char *p, const char *end) {
+#if defined(__SSE2__) || defined(_M_X64)
+  while (end - p >= 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i control =
+        _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1F)),
+                       _mm_set1_epi8(0x1F));
+    const __m128i special =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                     control);
+    const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+    if (mask != 0)
+      return p + std::countr_zero(mask);
+    p += 16;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  while (end - p >= 16) {
+    const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    const uint8x16_t special =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')),
+                          vceqq_u8(v, vdupq_n_u8('\\'))),
+                 vcltq_u8(v, vdupq_n_u8(0x20)));
+    if (vmaxvq_u8(special) != 0)
+      break;
+    p += 16;
+  }
+#endif
+  while (p < end && *p != '"' && *p != '\\' &&
+         static_cast<unsigned char>(*p) >= 0x20)
+    p++;
+  return p;
+}
+
+static void AppendUtf8(std::string &out, const uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+struct Parser {
+  JSContext *Ctx;
+  const char *Begin;
+  const char *Cur;
+  const char *End;
+  // keys without escapes point into the input, so lookups don't copy
+  std::unordered_map<std::string_view, JSAtom> Keys{};
+  std::string Scratch{};
+  uint32_t Depth{0};
+
+  Parser(JSContext *ctx, const std::string_view json)
+      : Ctx(ctx), Begin(json.data()), Cur(json.data()),
+        End(json.data() + json.size()) {}
+
+  ~Parser() {
+    for (const auto &[key, atom] : Keys)
+      JS_FreeAtom(Ctx, atom);
+  }
+
+  JSValue Fail(const char *message) const {
+    return JS_ThrowSyntaxError(Ctx, "JSON: %s at position %zu", message,
+                               static_cast<size_t>(Cur - Begin));
+  }
+
+  JSValue Parse() {
+    Cur = SkipSpace(Cur, End);
+    JSValue value = ParseValue();
+    if (JS_IsException(value))
+      return value;
+    Cur = SkipSpace(Cur, End);
+    if (Cur != End) {
+      JS_FreeValue(Ctx, value);
+      return Fail("unexpected data after the value");
+    }
+    return value;
+  }
+
+  JSValue ParseValue() {
+    if (Cur >= End)
+      return Fail("unexpected end of input");
+    switch (*Cur) {
+    case '{': return ParseObject();
+    case '[': return ParseArray();
+    case '"': {
+      std::string_view str;
+      if (!ParseString(str))
+        return JS_EXCEPTION;
+      return JS_NewStringLen(Ctx, str.data(), str.size());
+    }
+    case 't': return ParseLiteral("true", JS_TRUE);
+    case 'f': return ParseLiteral("false", JS_FALSE);
+    case 'n': return ParseLiteral("null", JS_NULL);
+    default: return ParseNumber();
+    }
+  }
+
+  JSValue ParseLiteral(const std::string_view literal, const JSValue value) {
+    if (static_cast<size_t>(End - Cur) < literal.size() ||
+        std::memcmp(Cur, literal.data(), literal.size()) != 0)
+      return Fail("unexpected token");
+    Cur += literal.size();
+    return value;
+  }
+
+  JSValue ParseNumber() {
+    const char *start = Cur;
+    const bool negative = Cur < End && *Cur == '-';
+    if (negative)
+      Cur++;
+    if (Cur >= End || *Cur < '0' || *Cur > '9')
+      return Fail("unexpected token");
+
+    // fast path for integers up to 15 digits, those are exact as double
+    int64_t integer = 0;
+    int digits = 0;
+    if (*Cur == '0') {
+      Cur++;
+    } else {
+      for (; Cur < End && *Cur >= '0' && *Cur <= '9'; Cur++, digits++) {
+        integer = integer * 10 + (*Cur - '0');
+        if (digits > 15)
+          integer = 0;
+      }
+    }
+    bool isInteger = digits <= 15;
+    if (Cur < End && *Cur == '.') {
+      isInteger = false;
+      if (++Cur >= End || *Cur < '0' || *Cur > '9')
+        return Fail("invalid number");
+      while (Cur < End && *Cur >= '0' && *Cur <= '9')
+        Cur++;
+    }
+    if (Cur < End && (*Cur == 'e' || *Cur == 'E')) {
+      isInteger = false;
+      if (++Cur < End && (*Cur == '+' || *Cur == '-'))
+        Cur++;
+      if (Cur >= End || *Cur < '0' || *Cur > '9')
+        return Fail("invalid number");
+      while (Cur < End && *Cur >= '0' && *Cur <= '9')
+        Cur++;
+    }
+
+    if (isInteger && !(negative && integer == 0)) {
+      integer = negative ? -integer : integer;
+      if (integer >= INT32_MIN && integer <= INT32_MAX)
+        return JS_NewInt32(Ctx, static_cast<int32_t>(integer));
+      return JS_NewFloat64(Ctx, static_cast<double>(integer));
+    }
+    double value = 0;
+    const auto result = std::from_chars(start, Cur, value);
+    if (result.ec == std::errc::result_out_of_range) {
+      // from_chars leaves the value alone here, strtod gives us inf or 0
+      const std::string copy(start, Cur);
+      value = std::strtod(copy.c_str(), nullptr);
+    }
+    return JS_NewFloat64(Ctx, value);
+  }
+
+  // Cur has to be at the opening quote. The result points into the input
+  // if there are no escapes, otherwise into Scratch.
+  bool ParseString(std::string_view &out) {
+    const char *start = ++Cur;
+    Cur = ScanString(Cur, End);
+    if (Cur < End && *Cur == '"') {
+      out = {start, static_cast<size_t>(Cur - start)};
+      Cur++;
+      return true;
+    }
+
+    Scratch.assign(start, Cur);
+    while (Cur < End) {
+      const char c = *Cur;
+      if (c == '"') {
+        Cur++;
+        out = Scratch;
+        return true;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        Fail("control character in string");
+        return false;
+      }
+      if (c != '\\') {
+        const char *next = ScanString(Cur, End);
+        Scratch.append(Cur, next);
+        Cur = next;
+        continue;
+      }
+      if (++Cur >= End)
+        break;
+      switch (*Cur++) {
+      case '"': Scratch += '"'; break;
+      case '\\': Scratch += '\\'; break;
+      case '/': Scratch += '/'; break;
+      case 'b': Scratch += '\b'; break;
+      case 'f': Scratch += '\f'; break;
+      case 'n': Scratch += '\n'; break;
+      case 'r': Scratch += '\r'; break;
+      case 't': Scratch += '\t'; break;
+      case 'u': {
+        uint32_t cp = 0;
+        if (!ParseHex(cp))
+          return false;
+        // combine surrogate pairs, lone surrogates are kept as they are
+        if (cp >= 0xD800 && cp <= 0xDBFF && End - Cur >= 6 && Cur[0] == '\\' &&
+            Cur[1] == 'u') {
+          const char *save = Cur;
+          Cur += 2;
+          uint32_t low = 0;
+          if (!ParseHex(low))
+            return false;
+          if (low >= 0xDC00 && low <= 0xDFFF)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          else
+            Cur = save;
+        }
+        AppendUtf8(Scratch, cp);
+        break;
+      }
+      default: Fail("invalid escape"); return false;
+      }
+    }
+    Fail("unterminated string");
+    return false;
+  }
+
+  bool ParseHex(uint32_t &out) {
+    if (End - Cur < 4) {
+      Fail("invalid unicode escape");
+      return false;
+    }
+    const auto result = std::from_chars(Cur, Cur + 4, out, 16);
+    if (result.ptr != Cur + 4) {
+      Fail("invalid unicode escape");
+      return false;
+    }
+    Cur += 4;
+    return true;
+  }
+
+  JSAtom ParseKey() {
+    std::string_view key;
+    if (!ParseString(key))
+      return JS_ATOM_NULL;
+    // only cache keys that live in the input
+    if (key.data() == Scratch.data())
+      return JS_NewAtomLen(Ctx, key.data(), key.size());
+    auto it = Keys.find(key);
+    if (it == Keys.end())
+      it = Keys.emplace(key, JS_NewAtomLen(Ctx, key.data(), key.size())).first;
+    return JS_DupAtom(Ctx, it->second);
+  }
+
+  JSValue ParseObject() {
+    if (++Depth > MaxDepth)
+      return Fail("too deeply nested");
+    JSValue obj = JS_NewObject(Ctx);
+    Cur = SkipSpace(Cur + 1, End);
+    if (Cur < End && *Cur == '}') {
+      Cur++;
+      Depth--;
+      return obj;
+    }
+    while (true) {
+      if (Cur >= End || *Cur != '"')
+        return Abort(obj, "expected a key");
+      const JSAtom key = ParseKey();
+      if (key == JS_ATOM_NULL)
+        return Abort(obj, nullptr);
+      Cur = SkipSpace(Cur, End);
+      if (Cur >= End || *Cur != ':') {
+        JS_FreeAtom(Ctx, key);
+        return Abort(obj, "expected ':'");
+      }
+      Cur = SkipSpace(Cur + 1, End);
+      JSValue value = ParseValue();
+      if (JS_IsException(value)) {
+        JS_FreeAtom(Ctx, key);
+        return Abort(obj, nullptr);
+      }
+      JS_DefinePropertyValue(Ctx, obj, key, value, JS_PROP_C_W_E);
+      JS_FreeAtom(Ctx, key);
+      Cur = SkipSpace(Cur, End);
+      if (Cur < End && *Cur == ',') {
+        Cur = SkipSpace(Cur + 1, End);
+        continue;
+      }
+      if (Cur < End && *Cur == '}') {
+        Cur++;
+        Depth--;
+        return obj;
+      }
+      return Abort(obj, "expected ',' or '}'");
+    }
+  }
+
+  JSValue ParseArray() {
+    if (++Depth > MaxDepth)
+      return Fail("too deeply nested");
+    JSValue array = JS_NewArray(Ctx);
+    Cur = SkipSpace(Cur + 1, End);
+    if (Cur < End && *Cur == ']') {
+      Cur++;
+      Depth--;
+      return array;
+    }
+    for (uint32_t index = 0;; index++) {
+      JSValue value = ParseValue();
+      if (JS_IsException(value))
+        return Abort(array, nullptr);
+      JS_DefinePropertyValueUint32(Ctx, array, index, value, JS_PROP_C_W_E);
+      Cur = SkipSpace(Cur, End);
+      if (Cur < End && *Cur == ',') {
+        Cur = SkipSpace(Cur + 1, End);
+        continue;
+      }
+      if (Cur < End && *Cur == ']') {
+        Cur++;
+        Depth--;
+        return array;
+      }
+      return Abort(array, "expected ',' or ']'");
+    }
+  }
+
+  // message is null if the exception is already set
+  JSValue Abort(const JSValue value, const char *message) const {
+    JS_FreeValue(Ctx, value);
+    return message ? Fail(message) : JS_EXCEPTION;
+  }
+};
+
+// Same output as Number.prototype.toString, from the shortest round trip
+// digits that to_chars gives us
+static void AppendNumber(std::string &out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  if (value == 0) {
+    out += '0';
+    return;
+  }
+  if (std::trunc(value) == value && std::fabs(value) < 9007199254740992.0) {
+    const auto end = std::to_chars(buffer, buffer + sizeof(buffer),
+                                   static_cast<int64_t>(value))
+                         .ptr;
+    out.append(buffer, end);
+    return;
+  }
+  if (value < 0) {
+    out += '-';
+    value = -value;
+  }
+  // d.ddddde[+-]x
+  const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                                 std::chars_format::scientific)
+                       .ptr;
+  const char *exponent = static_cast<const char *>(
+      std::memchr(buffer, 'e', static_cast<size_t>(end - buffer)));
+  char digits[20];
+  int k = 0;
+  for (const char *p = buffer; p < exponent; p++) {
+    if (*p != '.')
+      digits[k++] = *p;
+  }
+  int n = 0;
+  // from_chars doesn't like the + sign
+  std::from_chars(exponent + (exponent[1] == '+' ? 2 : 1), end, n);
+  n += 1;
+
+  if (k <= n && n <= 21) {
+    out.append(digits, k);
+    out.append(static_cast<size_t>(n - k), '0');
+  } else if (0 < n && n <= 21) {
+    out.append(digits, n);
+    out += '.';
+    out.append(digits + n, k - n);
+  } else if (-6 < n && n <= 0) {
+    out += "0.";
+    out.append(static_cast<size_t>(-n), '0');
+    out.append(digits, k);
+  } else {
+    out += digits[0];
+    if (k > 1) {
+      out += '.';
+      out.append(digits + 1, k - 1);
+    }
+    out += 'e';
+    out += n - 1 < 0 ? '-' : '+';
+    const auto expEnd = std::to_chars(buffer, buffer + sizeof(buffer),
+                                      std::abs(n - 1))
+                            .ptr;
+    out.append(buffer, expEnd);
+  }
+}
+
+static constexpr char Hex[] = "0123456789abcdef";
+
+static void AppendEscaped(std::string &out, const char *str, const size_t len) {
+  const char *p = str;
+  const char *end = str + len;
+  while (p < end) {
+    const char *next = ScanString(p, end);
+    out.append(p, next);
+    if (next >= end)
+      break;
+    const auto c = static_cast<unsigned char>(*next);
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      out += "\\u00";
+      out += Hex[c >> 4];
+      out += Hex[c & 0xF];
+    }
+    p = next + 1;
+  }
+}
+
+static void AppendQuoted(std::string &out, const char *str, const size_t len) {
+  out += '"';
+  AppendEscaped(out, str, len);
+  out += '"';
+}
+
+// str is CESU-8, so every surrogate is its own 3 byte sequence. Pairs become
+// one 4 byte UTF-8 character again, lone ones are written as \udxxx like
+// JSON.stringify does it
+static void AppendQuotedCesu(std::string &out, const char *str,
+                             const size_t len) {
+  const char *p = str;
+  const char *end = str + len;
+  out += '"';
+  while (p < end) {
+    const auto *lead = static_cast<const char *>(
+        std::memchr(p, 0xED, static_cast<size_t>(end - p)));
+    // ED 80-9F is a regular character, ED A0-BF a surrogate
+    if (!lead || end - lead < 3 ||
+        static_cast<unsigned char>(lead[1]) < 0xA0) {
+      const char *next = lead && end - lead >= 3 ? lead + 3 : end;
+      AppendEscaped(out, p, static_cast<size_t>(next - p));
+      p = next;
+      continue;
+    }
+    AppendEscaped(out, p, static_cast<size_t>(lead - p));
+    const auto unit = [](const char *q) {
+      return static_cast<uint32_t>(0xD000 |
+                                   ((static_cast<unsigned char>(q[1]) & 0x3F)
+                                    << 6) |
+                                   (static_cast<unsigned char>(q[2]) & 0x3F));
+    };
+    const uint32_t high = unit(lead);
+    if (high <= 0xDBFF && end - lead >= 6 &&
+        static_cast<unsigned char>(lead[3]) == 0xED &&
+        static_cast<unsigned char>(lead[4]) >= 0xB0) {
+      const uint32_t low = unit(lead + 3);
+      AppendUtf8(out, 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00));
+      p = lead + 6;
+      continue;
+    }
+    out += "\\u";
+    out += Hex[(high >> 12) & 0xF];
+    out += Hex[(high >> 8) & 0xF];
+    out += Hex[(high >> 4) & 0xF];
+    out += Hex[high & 0xF];
+    p = lead + 3;
+  }
+  out += '"';
+}
+
+// quickjs-ng doesn't export the class ids of the boxed primitives. They are
+// the same on every runtime, so they are probed once on a fresh one where no
+// script could have replaced the constructors. 0 never matches an object.
+struct BoxedClasses {
+  JSClassID Number{0};
+  JSClassID String{0};
+  JSClassID Boolean{0};
+};
+
+static const BoxedClasses &GetBoxedClasses() {
+  static const BoxedClasses classes = [] {
+    BoxedClasses ids{};
+    JSRuntime *rt = JS_NewRuntime();
+    JSContext *ctx = rt ? JS_NewContext(rt) : nullptr;
+    if (ctx) {
+      static constexpr char Probe[] =
+          "[new Number(0), new String(''), new Boolean(false)]";
+      JSValue boxed = JS_Eval(ctx, Probe, sizeof(Probe) - 1, "<json-probe>",
+                              JS_EVAL_TYPE_GLOBAL);
+      const auto classOf = [&](const uint32_t index) {
+        JSValue value = JS_GetPropertyUint32(ctx, boxed, index);
+        const JSClassID id = JS_GetClassID(value);
+        JS_FreeValue(ctx, value);
+        return id;
+      };
+      ids = {classOf(0), classOf(1), classOf(2)};
+      JS_FreeValue(ctx, boxed);
+      JS_FreeContext(ctx);
+    }
+    if (rt)
+      JS_FreeRuntime(rt);
+    return ids;
+  }();
+  return classes;
+}
+
+// stringify keeps its buffer between calls, up to this size
+static constexpr size_t MaxKeptBuffer = 1024 * 1024;
+
+// Where a value is stored, toJSON gets it as its argument
+struct Key {
+  JSAtom Atom{JS_ATOM_NULL};
+  uint32_t Index{0};
+  bool IsIndex{false};
+};
+
+struct Writer {
+  JSContext *Ctx;
+  std::string &Out;
+  std::vector<void *> Stack{};
+  const BoxedClasses &Boxed{GetBoxedClasses()};
+
+  // undefined, functions and symbols are left out of objects
+  bool IsSkipped(const JSValue value) const {
+    return JS_IsUndefined(value) || JS_IsSymbol(value) ||
+           JS_IsFunction(Ctx, value);
+  }
+
+  bool Write(JSValue value, const Key &key = {}) {
+    switch (JS_VALUE_GET_TAG(value)) {
+    case JS_TAG_NULL:
+    case JS_TAG_UNDEFINED: Out += "null"; return true;
+    case JS_TAG_BOOL:
+      Out += JS_VALUE_GET_BOOL(value) ? "true" : "false";
+      return true;
+    case JS_TAG_INT: {
+      char buffer[16];
+      const auto end = std::to_chars(buffer, buffer + sizeof(buffer),
+                                     JS_VALUE_GET_INT(value))
+                           .ptr;
+      Out.append(buffer, end);
+      return true;
+    }
+    case JS_TAG_FLOAT64:
+      AppendNumber(Out, JS_VALUE_GET_FLOAT64(value));
+      return true;
+    case JS_TAG_STRING: return WriteString(value);
+    case JS_TAG_OBJECT: return WriteObject(value, key);
+    case JS_TAG_BIG_INT:
+      JS_ThrowTypeError(Ctx, "BigInt value can't be serialized in JSON");
+      return false;
+    default: Out += "null"; return true;
+    }
+  }
+
+  bool WriteString(const JSValue value) const {
+    size_t len = 0;
+    // CESU-8 keeps lone surrogates, plain UTF-8 would replace them
+    const char *str = JS_ToCStringLen2(Ctx, &len, value, true);
+    if (!str)
+      return false;
+    if (std::memchr(str, 0xED, len))
+      AppendQuotedCesu(Out, str, len);
+    else
+      AppendQuoted(Out, str, len);
+    JS_FreeCString(Ctx, str);
+    return true;
+  }
+
+  bool WriteObject(const JSValue value, const Key &key,
+                   const bool callToJSON = true) {
+    if (callToJSON) {
+      JSValue toJSON = JS_GetPropertyStr(Ctx, value, "toJSON");
+      if (JS_IsException(toJSON))
+        return false;
+      if (JS_IsFunction(Ctx, toJSON))
+        return WriteToJSON(value, toJSON, key);
+      JS_FreeValue(Ctx, toJSON);
+    }
+    const JSClassID id = JS_GetClassID(value);
+    if (id == Boxed.Number || id == Boxed.Boolean)
+      return WriteBoxed(value);
+    if (id == Boxed.String) {
+      JSValue str = JS_ToString(Ctx, value);
+      if (JS_IsException(str))
+        return false;
+      const bool ok = WriteString(str);
+      JS_FreeValue(Ctx, str);
+      return ok;
+    }
+
+    void *ptr = JS_VALUE_GET_PTR(value);
+    for (const void *item : Stack) {
+      if (item == ptr) {
+        JS_ThrowTypeError(Ctx, "circular structure in JSON");
+        return false;
+      }
+    }
+    if (Stack.size() >= MaxDepth) {
+      JS_ThrowRangeError(Ctx, "too deeply nested for JSON");
+      return false;
+    }
+    Stack.push_back(ptr);
+    const bool ok =
+        JS_IsArray(Ctx, value) ? WriteArray(value) : WriteProperties(value);
+    Stack.pop_back();
+    return ok;
+  }
+
+  // new Number(1) and new Boolean(false) are written as their value
+  bool WriteBoxed(const JSValue value) {
+    double number = 0;
+    if (JS_ToFloat64(Ctx, &number, value) < 0)
+      return false;
+    if (JS_GetClassID(value) == Boxed.Boolean)
+      Out += number != 0 ? "true" : "false";
+    else
+      AppendNumber(Out, number);
+    return true;
+  }
+
+  JSValue KeyString(const Key &key) const {
+    if (!key.IsIndex)
+      return key.Atom == JS_ATOM_NULL ? JS_NewString(Ctx, "")
+                                      : JS_AtomToString(Ctx, key.Atom);
+    char buffer[16];
+    const auto end =
+        std::to_chars(buffer, buffer + sizeof(buffer), key.Index).ptr;
+    return JS_NewStringLen(Ctx, buffer, static_cast<size_t>(end - buffer));
+  }
+
+  bool WriteToJSON(const JSValue value, const JSValue toJSON,
+                   const Key &key) {
+    JSValue name = KeyString(key);
+    JSValue result = JS_IsException(name)
+                         ? JS_EXCEPTION
+                         : JS_Call(Ctx, toJSON, value, 1, &name);
+    JS_FreeValue(Ctx, name);
+    JS_FreeValue(Ctx, toJSON);
+    if (JS_IsException(result))
+      return false;
+    bool ok = true;
+    if (IsSkipped(result))
+      Out += "null";
+    else if (JS_IsObject(result))
+      ok = WriteObject(result, key, false);
+    else
+      ok = Write(result);
+    JS_FreeValue(Ctx, result);
+    return ok;
+  }
+
+  bool WriteArray(const JSValue value) {
+    JSValue length = JS_GetPropertyStr(Ctx, value, "length");
+    uint32_t size = 0;
+    JS_ToUint32(Ctx, &size, length);
+    JS_FreeValue(Ctx, length);
+    Out += '[';
+    for (uint32_t i = 0; i < size; i++) {
+      if (i > 0)
+        Out += ',';
+      JSValue item = JS_GetPropertyUint32(Ctx, value, i);
+      if (JS_IsException(item))
+        return false;
+      const bool ok = IsSkipped(item) ? (Out += "null", true)
+                                      : Write(item, {JS_ATOM_NULL, i, true});
+      JS_FreeValue(Ctx, item);
+      if (!ok)
+        return false;
+    }
+    Out += ']';
+    return true;
+  }
+
+  bool WriteProperties(const JSValue value) {
+    JSPropertyEnum *props = nullptr;
+    uint32_t count = 0;
+    if (JS_GetOwnPropertyNames(Ctx, &props, &count, value,
+                               JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0)
+      return false;
+    bool ok = true;
+    bool first = true;
+    Out += '{';
+    for (uint32_t i = 0; i < count && ok; i++) {
+      JSValue item = JS_GetProperty(Ctx, value, props[i].atom);
+      if (JS_IsException(item)) {
+        ok = false;
+        break;
+      }
+      if (!IsSkipped(item)) {
+        if (!first)
+          Out += ',';
+        first = false;
+        size_t len = 0;
+        const char *key = JS_AtomToCStringLen(Ctx, &len, props[i].atom);
+        if (key) {
+          AppendQuoted(Out, key, len);
+          JS_FreeCString(Ctx, key);
+          Out += ':';
+          ok = Write(item, {props[i].atom});
+        } else {
+          ok = false;
+        }
+      }
+      JS_FreeValue(Ctx, item);
+    }
+    JS_FreePropertyEnum(Ctx, props, count);
+    Out += '}';
+    return ok;
+  }
+};
+
+static JSValue ParseInput(JSContext *ctx, JSValueConst input) {
+  if (JS_IsString(input)) {
+    size_t len = 0;
+    const char *str = JS_ToCStringLen(ctx, &len, input);
+    if (!str)
+      return JS_EXCEPTION;
+    JSValue result = Parser{ctx, {str, len}}.Parse();
+    JS_FreeCString(ctx, str);
+    return result;
+  }
+  size_t size = 0;
+  // JS_GetArrayBuffer takes SharedArrayBuffers as well
+  const uint8_t *data = JS_GetArrayBuffer(ctx, &size, input);
+  if (!data && !JS_IsArrayBuffer(input)) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    data = JS_GetUint8Array(ctx, &size, input);
+  }
+  if (!data && size == 0 && JS_HasException(ctx)) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return JS_ThrowTypeError(ctx,
+                             "expected a string, ArrayBuffer or Uint8Array");
+  }
+  const auto *json = reinterpret_cast<const char *>(data);
+  return Parser{ctx, {json ? json : "", size}}.Parse();
+}
+
+static JSValue JsonParse(JSContext *ctx, JSValueConst, int,
+                         JSValueConst *argv) {
+  return ParseInput(ctx, argv[0]);
+}
+
+static JSValue JsonStringify(JSContext *ctx, JSValueConst, int,
+                             JSValueConst *argv) {
+  if (JS_IsUndefined(argv[0]) || JS_IsSymbol(argv[0]) ||
+      JS_IsFunction(ctx, argv[0]))
+    return JS_UNDEFINED;
+  // reused between calls, a toJSON calling stringify gets its own
+  thread_local std::string buffer;
+  thread_local bool busy = false;
+  std::string local;
+  std::string &out = busy ? local : buffer;
+  const bool owner = !busy;
+  busy = true;
+  out.clear();
+  Writer writer{ctx, out};
+  const bool ok = writer.Write(argv[0]);
+  const JSValue result =
+      ok ? JS_NewStringLen(ctx, out.data(), out.size()) : JS_EXCEPTION;
+  if (owner) {
+    busy = false;
+    // one huge document shouldn't stay around on every thread
+    if (buffer.capacity() > MaxKeptBuffer) {
+      buffer.clear();
+      buffer.shrink_to_fit();
+    }
+  }
+  return result;
+}
+
+Value Json::Parse(const Value &ctx, const std::string_view json) {
+  JSContext *context = ctx.m_Context;
+  return Value{ctx.m_Context, FROM(Parser(context, json).Parse())};
+}
+
+bool Json::Stringify(const Value &value, std::string &out) {
+  Writer writer{value.m_Context, out};
+  const JSValue val = TO(value.m_UnderlyingValue);
+  if (writer.IsSkipped(val))
+    return true;
+  return writer.Write(val);
+}
+
+void Json::Install(const Value &target) {
+  // probed up front, not in the middle of the first stringify
+  (void)GetBoxedClasses();
+  JSContext *ctx = target.m_Context;
+  JSValue json = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, json, "parse",
+                    JS_NewCFunction(ctx, &JsonParse, "parse", 1));
+  JS_SetPropertyStr(ctx, json, "stringify",
+                    JS_NewCFunction(ctx, &JsonStringify, "stringify", 1));
+  JS_SetPropertyStr(ctx, TO(target.m_UnderlyingValue), "json", json);
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
@@ -0,0 +1,157 @@
+#include "ObjectProvider.h"
+#include "impl.h"
+
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+struct ObjectProviderUtils {
+  // the exotic methods and the finalizer only ever see our own class, so any
+  // opaque is fine here and we don't need the per runtime id
+  static Ref<ObjectProvider> *GetProvider(JSValueConst obj) {
+    JSClassID id = 0;
+    return static_cast<Ref<ObjectProvider> *>(JS_GetAnyOpaque(obj, &id));
+  }
+
+  static Context &GetContext(JSContext *ctx) {
+    return static_cast<Instance *>(JS_GetContextOpaque(ctx))->GetContext();
+  }
+
+  // false for symbols, providers only know about string keys
+  static bool GetKey(JSContext *ctx, const JSAtom prop, std::string &key) {
+    JSValue value = JS_AtomToValue(ctx, prop);
+    if (JS_IsSymbol(value) || JS_IsException(value)) {
+      JS_FreeValue(ctx, value);
+      return false;
+    }
+    size_t len = 0;
+    const char *str = JS_ToCStringLen(ctx, &len, value);
+    JS_FreeValue(ctx, value);
+    if (!str)
+      return false;
+    key.assign(str, len);
+    JS_FreeCString(ctx, str);
+    return true;
+  }
+
+  static int GetOwnProperty(JSContext *ctx, JSPropertyDescriptor *desc,
+                            JSValueConst obj, const JSAtom prop) {
+    auto *provider = GetProvider(obj);
+    std::string key;
+    if (!provider || !GetKey(ctx, prop, key))
+      return 0;
+    const Value self = Value::FromCtx(GetContext(ctx), &obj);
+    Value out{};
+    if (!(*provider)->Get(self, key, out))
+      return 0;
+    if (out.IsException())
+      return -1;
+    if (desc) {
+      desc->flags =
+          JS_PROP_ENUMERABLE | JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE;
+      desc->value = JS_DupValue(ctx, TO(out.m_UnderlyingValue));
+      desc->getter = JS_UNDEFINED;
+      desc->setter = JS_UNDEFINED;
+    }
+    return 1;
+  }
+
+  static int GetOwnPropertyNames(JSContext *ctx, JSPropertyEnum **ptab,
+                                 uint32_t *plen, JSValueConst obj) {
+    *ptab = nullptr;
+    *plen = 0;
+    auto *provider = GetProvider(obj);
+    if (!provider)
+      return 0;
+    const auto keys = (*provider)->Keys();
+    if (keys.empty())
+      return 0;
+    auto *tab = static_cast<JSPropertyEnum *>(
+        js_malloc(ctx, sizeof(JSPropertyEnum) * keys.size()));
+    if (!tab)
+      return -1;
+    for (size_t i = 0; i < keys.size(); i++) {
+      tab[i].is_enumerable = true;
+      tab[i].atom = JS_NewAtomLen(ctx, keys[i].c_str(), keys[i].size());
+    }
+    *ptab = tab;
+    *plen = static_cast<uint32_t>(keys.size());
+    return 0;
+  }
+
+  static int SetProperty(JSContext *ctx, JSValueConst obj, const JSAtom prop,
+                         JSValueConst value, JSValueConst, int) {
+    auto *provider = GetProvider(obj);
+    std::string key;
+    if (provider && GetKey(ctx, prop, key)) {
+      Context &context = GetContext(ctx);
+      if ((*provider)->Set(Value::FromCtx(context, &obj), key,
+                           Value::FromCtx(context, &value)))
+        return JS_HasException(ctx) ? -1 : 1;
+    }
+    return JS_DefinePropertyValue(ctx, obj, prop, JS_DupValue(ctx, value),
+                                  JS_PROP_C_W_E);
+  }
+
+  static void Finalize(JSRuntime *, JSValue val) {
+    delete GetProvider(val);
+  }
+
+  // registered like a ClassBinding, once per runtime. The key just has to
+  // be unique, the entry doesn't own anything. There's no prototype to set
+  // per Context.
+  static JSClassID Register(const Context &context) {
+    static const char key = 0;
+    if (const JSClassID id = context.GetClassID(&key))
+      return id;
+
+    // quickjs keeps the pointer, workers may register at the same time
+    static const JSClassExoticMethods exotic = [] {
+      JSClassExoticMethods methods{};
+      methods.get_own_property = &GetOwnProperty;
+      methods.get_own_property_names = &GetOwnPropertyNames;
+      methods.set_property = &SetProperty;
+      return methods;
+    }();
+    JSClassDef def{};
+    def.class_name = "NativeObject";
+    def.finalizer = &Finalize;
+    def.exotic = const_cast<JSClassExoticMethods *>(&exotic);
+
+    JSRuntime *rt = context;
+    JSClassID id = 0;
+    JS_NewClassID(rt, &id);
+    JS_NewClass(rt, id, &def);
+    context.SetClassID(&key, id, nullptr);
+    return id;
+  }
+
+  static Value New(const Context &context,
+                   const Ref<ObjectProvider> &provider) {
+    const JSClassID id = Register(context);
+    JSValue obj = JS_NewObjectClass(context, static_cast<int>(id));
+    JS_SetOpaque(obj, new Ref<ObjectProvider>(provider));
+    return Value(context, FROM(obj));
+  }
+
+  static Value New(const Value &ctx, const Ref<ObjectProvider> &provider) {
+    return New(ctx.m_Context, provider);
+  }
+};
+
+Value ObjectProvider::New(Instance &instance,
+                          const Ref<ObjectProvider> &provider) {
+  return ObjectProviderUtils::New(instance.GetContext(), provider);
+}
+
+Value ObjectProvider::New(const Value &ctx,
+                          const Ref<ObjectProvider> &provider) {
+  return ObjectProviderUtils::New(ctx, provider);
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
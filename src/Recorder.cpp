@@ -0,0 +1,242 @@
+#include "Recorder.h"
+#include "impl.h"
+
+#include <cstring>
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+static constexpr size_t FlushSize = 64 * 1024;
+
+template <typename T> static void Append(std::vector<uint8_t> &out, T value) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T, typename Bytes>
+static bool Take(const Bytes &in, size_t &pos, T &value) {
+  if (pos + sizeof(T) > in.size())
+    return false;
+  std::memcpy(&value, in.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+// QuickJS can only write SharedArrayBuffers as pointers, which are useless
+// in a file. Top level ones and typed arrays on them are copied instead.
+static JSValue Unshare(JSContext *ctx, JSValueConst value) {
+  if (!JS_IsObject(value) || JS_IsArrayBuffer(value))
+    return JS_DupValue(ctx, value);
+  if (const int type = JS_GetTypedArrayType(value); type >= 0) {
+    size_t offset = 0;
+    size_t length = 0;
+    JSValue buffer =
+        JS_GetTypedArrayBuffer(ctx, value, &offset, &length, nullptr);
+    if (JS_IsException(buffer) || JS_IsArrayBuffer(buffer)) {
+      JS_FreeValue(ctx, buffer);
+      return JS_DupValue(ctx, value);
+    }
+    size_t size = 0;
+    const uint8_t *data = JS_GetArrayBuffer(ctx, &size, buffer);
+    JSValue copy = JS_NewArrayBufferCopy(ctx, data ? data + offset : nullptr,
+                                         data ? length : 0);
+    JS_FreeValue(ctx, buffer);
+    JSValue array = JS_NewTypedArray(ctx, 1, &copy,
+                                     static_cast<JSTypedArrayEnum>(type));
+    JS_FreeValue(ctx, copy);
+    return array;
+  }
+  size_t size = 0;
+  const uint8_t *data = JS_GetArrayBuffer(ctx, &size, value);
+  if (!data) {
+    // not a buffer at all
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return JS_DupValue(ctx, value);
+  }
+  return JS_NewArrayBufferCopy(ctx, data, size);
+}
+
+// Empty if value can't be cloned, nothing is left pending then
+static std::vector<uint8_t> Clone(JSContext *ctx, JSValueConst value) {
+  JSValue copy = Unshare(ctx, value);
+  size_t size = 0;
+  uint8_t *data =
+      JS_IsException(copy)
+          ? nullptr
+          : JS_WriteObject(ctx, &size, copy, JS_WRITE_OBJ_REFERENCE);
+  JS_FreeValue(ctx, copy);
+  if (!data) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return {};
+  }
+  std::vector<uint8_t> out(data, data + size);
+  js_free(ctx, data);
+  return out;
+}
+
+Recorder::Recorder(const std::string &file)
+    : m_File(file, std::ios::binary | std::ios::trunc),
+      m_Start(std::chrono::steady_clock::now()) {
+  m_Buffer.reserve(FlushSize * 2);
+  Append(m_Buffer, Magic);
+  Append(m_Buffer, Version);
+}
+
+Recorder::~Recorder() { Flush(); }
+
+bool Recorder::IsOpen() const { return m_File.is_open(); }
+
+void Recorder::Frame() { Write(Kind::Frame, {}); }
+
+void Recorder::Native(const std::string_view name) {
+  Write(Kind::Native, name);
+}
+
+void Recorder::Call(const Value &function, const std::vector<Value> &args) {
+  // replaying the outer call does these again
+  if (m_Depth > 0)
+    return;
+  JSContext *ctx = function.m_Context;
+  const Value name{
+      function.m_Context,
+      FROM(JS_GetPropertyStr(ctx, TO(function.m_UnderlyingValue), "name"))};
+  // count | size + clone per argument, one that can't be cloned doesn't
+  // take the others with it
+  std::vector<uint8_t> data;
+  Append(data, static_cast<uint32_t>(args.size()));
+  for (const auto &arg : args) {
+    const auto clone = Clone(ctx, TO(arg.m_UnderlyingValue));
+    Append(data, static_cast<uint32_t>(clone.size()));
+    data.insert(data.end(), clone.begin(), clone.end());
+  }
+  Write(Kind::Call, name.AsString(), data.data(), data.size());
+}
+
+void Recorder::Result(const std::string_view name, const Value &result) {
+  if (!result.IsException()) {
+    Write(Kind::Result, name, result);
+    return;
+  }
+  // the pending exception belongs to the script, it's only peeked at.
+  // Errors can't be cloned, their message can.
+  JSContext *ctx = result.m_Context;
+  JSValue error = JS_GetException(ctx);
+  auto data = Clone(ctx, error);
+  if (data.empty()) {
+    JSValue message = JS_ToString(ctx, error);
+    if (JS_IsException(message))
+      JS_FreeValue(ctx, JS_GetException(ctx));
+    else
+      data = Clone(ctx, message);
+    JS_FreeValue(ctx, message);
+  }
+  JS_Throw(ctx, error);
+  Write(Kind::Throw, name, data.data(), data.size());
+}
+
+void Recorder::Write(const Kind type, const std::string_view name,
+                     const Value &value) {
+  const auto data = Clone(value.m_Context, TO(value.m_UnderlyingValue));
+  Write(type, name, data.data(), data.size());
+}
+
+void Recorder::Write(const Kind type, const std::string_view name,
+                     const uint8_t *data, const size_t size) {
+  const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - m_Start);
+  Append(m_Buffer, type);
+  Append(m_Buffer, static_cast<uint64_t>(time.count()));
+  Append(m_Buffer, static_cast<uint32_t>(name.size()));
+  m_Buffer.insert(m_Buffer.end(), name.begin(), name.end());
+  Append(m_Buffer, static_cast<uint32_t>(size));
+  if (size > 0)
+    m_Buffer.insert(m_Buffer.end(), data, data + size);
+  if (m_Buffer.size() >= FlushSize)
+    Flush();
+}
+
+void Recorder::Flush() {
+  if (m_Buffer.empty() || !m_File.is_open())
+    return;
+  m_File.write(reinterpret_cast<const char *>(m_Buffer.data()),
+               static_cast<std::streamsize>(m_Buffer.size()));
+  m_File.flush();
+  m_Buffer.clear();
+}
+
+bool Recorder::Read(const std::string &file, std::vector<Event> &out) {
+  std::ifstream input(file, std::ios::binary);
+  if (!input.is_open())
+    return false;
+  const std::string in((std::istreambuf_iterator(input)),
+                       std::istreambuf_iterator<char>());
+  size_t pos = 0;
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  if (!Take(in, pos, magic) || !Take(in, pos, version) || magic != Magic ||
+      version != Version)
+    return false;
+  while (pos < in.size()) {
+    Event event;
+    uint64_t time = 0;
+    uint32_t nameSize = 0;
+    uint32_t dataSize = 0;
+    if (!Take(in, pos, event.Type) || event.Type > Kind::Throw ||
+        !Take(in, pos, time) || !Take(in, pos, nameSize) ||
+        pos + nameSize > in.size())
+      return false;
+    event.Time = std::chrono::nanoseconds(time);
+    event.Name.assign(in.data() + pos, nameSize);
+    pos += nameSize;
+    if (!Take(in, pos, dataSize) || pos + dataSize > in.size())
+      return false;
+    event.Data.assign(in.begin() + pos, in.begin() + pos + dataSize);
+    pos += dataSize;
+    out.push_back(std::move(event));
+  }
+  return true;
+}
+
+Value Recorder::Decode(const Value &ctx, const std::vector<uint8_t> &data) {
+  if (data.empty())
+    return ctx.Undefined();
+  const JSValue val = JS_ReadObject(ctx.m_Context, data.data(), data.size(),
+                                    JS_READ_OBJ_REFERENCE);
+  return Value{ctx.m_Context, FROM(val)};
+}
+
+std::vector<Value> Recorder::DecodeArgs(const Value &ctx,
+                                        const std::vector<uint8_t> &data) {
+  std::vector<Value> args;
+  size_t pos = 0;
+  uint32_t count = 0;
+  if (!Take(data, pos, count))
+    return args;
+  args.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t size = 0;
+    if (!Take(data, pos, size) || pos + size > data.size())
+      break;
+    const std::vector<uint8_t> arg(data.begin() + pos,
+                                   data.begin() + pos + size);
+    pos += size;
+    args.push_back(Decode(ctx, arg));
+  }
+  return args;
+}
+
+Value Recorder::Replay(const Value &ctx, const Event &event) {
+  Value value = Decode(ctx, event.Data);
+  if (event.Type != Kind::Throw || value.IsException())
+    return value;
+  JSContext *context = ctx.m_Context;
+  JS_Throw(context, JS_DupValue(context, TO(value.m_UnderlyingValue)));
+  return Value{ctx.m_Context, FROM(JS_EXCEPTION)};
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
@@ -0,0 +1,73 @@
+#include "Reflect.h"
+#include "impl.h"
+
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+const uint32_t *Reflection::Atoms(const Value &ctx, const void *type,
+                                  const char *const *names,
+                                  const size_t count) {
+  JSContext *context = ctx.m_Context;
+  auto *instance = static_cast<Instance *>(JS_GetContextOpaque(context));
+  auto &atoms = instance->m_Shapes[type];
+  if (atoms.empty()) {
+    atoms.reserve(count);
+    for (size_t i = 0; i < count; i++)
+      atoms.push_back(JS_NewAtom(context, names[i]));
+  }
+  return atoms.data();
+}
+
+Value Reflection::Get(const Value &obj, const uint32_t atom) {
+  return Value{obj.m_Context,
+               FROM(JS_GetProperty(obj.m_Context, TO(obj.m_UnderlyingValue),
+                                   atom))};
+}
+
+void Reflection::Define(const Value &obj, const uint32_t atom,
+                        const Value &value) {
+  JS_DefinePropertyValue(obj.m_Context, TO(obj.m_UnderlyingValue), atom,
+                         JS_DupValue(obj.m_Context,
+                                     TO(value.m_UnderlyingValue)),
+                         JS_PROP_C_W_E);
+}
+
+Value Reflection::Int(const Value &ctx, const int64_t value) {
+  // stays a tagged int if it fits, which is what scripts would produce
+  return Value{ctx.m_Context, FROM(JS_NewInt64(ctx.m_Context, value))};
+}
+
+Value Reflection::GetIndex(const Value &array, const uint32_t index) {
+  return Value{array.m_Context,
+               FROM(JS_GetPropertyUint32(array.m_Context,
+                                         TO(array.m_UnderlyingValue), index))};
+}
+
+void Reflection::SetIndex(const Value &array, const uint32_t index,
+                          const Value &value) {
+  JS_SetPropertyUint32(array.m_Context, TO(array.m_UnderlyingValue), index,
+                       JS_DupValue(array.m_Context,
+                                   TO(value.m_UnderlyingValue)));
+}
+
+uint32_t Reflection::Length(const Value &array) {
+  const JSValue size =
+      JS_GetPropertyStr(array.m_Context, TO(array.m_UnderlyingValue), "length");
+  uint32_t length = 0;
+  JS_ToUint32(array.m_Context, &length, size);
+  JS_FreeValue(array.m_Context, size);
+  return length;
+}
+
+bool Reflection::IsNullish(const Value &value) {
+  const JSValue val = TO(value.m_UnderlyingValue);
+  return JS_IsUndefined(val) || JS_IsNull(val);
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
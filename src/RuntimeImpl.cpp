@@ -1,16 +1,26 @@
+#include "impl.h"
 #include "vqjs.h"
 
+#ifdef VQJS_DSP
+#include <DSP.h>
+#endif
+#include <Bundle.h>
 #include <File.h>
+#include <Json.h>
+#include <Worker.h>
 #include <filesystem>
 #include <quickjs/quickjs.h>
 #include <vector>
 
 namespace VQJS {
-#define LOGF(Method)                                                           \
+#define LOGF(Name)                                                             \
   [](const Value &_, const std::vector<Value> &args) {                         \
     auto &logger = _.GetRuntime() -> GetLogger();                              \
+    if (!logger.Enabled(Logger::Level::Name))                                  \
+      return _.Undefined();                                                    \
     for (const auto &item : args) {                                            \
-      logger.Method(item.AsString());                                          \
+      const auto line = item.Borrow();                                         \
+      logger.Log(Logger::Level::Name, line ? line.View() : "null");            \
     }                                                                          \
     return _.Undefined();                                                      \
   }
@@ -56,6 +66,11 @@ static void PrepareStd(const Context &context, bool allowFS) {
     consoleV.AddFunction("warn", LOGF(Warn));
     global.Set("console", consoleV);
   }
+  {
+    auto vqjs = global.Object();
+    Json::Install(vqjs);
+    global.Set("vqjs", vqjs);
+  }
 
   if (allowFS) {
     auto fs = global.Object();
@@ -68,10 +83,60 @@ static void PrepareStd(const Context &context, bool allowFS) {
 }
 
 struct Loader {
+  static JSModuleDef *LoadNativeModule(JSContext *ctx, const char *module_name,
+                                       const NativeModule &module) {
+    if (module.Create)
+      return module.Create(ctx, module_name);
+    JSModuleDef *m = JS_NewCModule(ctx, module_name, &InitNativeModule);
+    if (!m)
+      return nullptr;
+    for (const auto &name : module.Exports) {
+      JS_AddModuleExport(ctx, m, name.c_str());
+    }
+    return m;
+  }
+
+  // Called once per context, the first time the module gets evaluated
+  static int InitNativeModule(JSContext *ctx, JSModuleDef *m) {
+    auto *instance = static_cast<Instance *>(JS_GetContextOpaque(ctx));
+    auto *runtime =
+        static_cast<Runtime *>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    const JSAtom atom = JS_GetModuleName(ctx, m);
+    const char *name = JS_AtomToCString(ctx, atom);
+    JS_FreeAtom(ctx, atom);
+    if (!name)
+      return -1;
+    const auto &natives = runtime->GetLoader().NativeModules;
+    const auto native = natives.find(name);
+    JS_FreeCString(ctx, name);
+    if (native == natives.end())
+      return -1;
+
+    JSValue exports = JS_NewObject(ctx);
+    // an empty std::function would throw through the QuickJS frames
+    if (native->second.Initialize)
+      native->second.Initialize(
+          Value::FromCtx(instance->GetContext(), &exports));
+    for (const auto &item : native->second.Exports) {
+      JS_SetModuleExport(ctx, m, item.c_str(),
+                         JS_GetPropertyStr(ctx, exports, item.c_str()));
+    }
+    JS_FreeValue(ctx, exports);
+    return 0;
+  }
+
   static JSModuleDef *LoadModule(JSContext *ctx, const char *module_name,
                                  void *opaque) {
     auto *runtime = static_cast<Runtime *>(opaque);
-    const auto val = runtime->LoadFile(module_name, false);
+    const auto &natives = runtime->GetLoader().NativeModules;
+    if (const auto native = natives.find(module_name);
+        native != natives.end()) {
+      return LoadNativeModule(ctx, module_name, native->second);
+    }
+    // evaluate in the Context that imports it, might not be the app one
+    const auto *instance = static_cast<Instance *>(JS_GetContextOpaque(ctx));
+    const auto val =
+        instance->LoadFile(module_name, ModuleType::Module, false);
     if (val.IsException()) {
       runtime->GetLogger().Error(val.Exception().AsString());
       return nullptr;
@@ -101,14 +166,42 @@ Runtime::ModuleLoader &Runtime::ModuleLoader::Add(const std::string &a,
   return *this;
 }
 
+Runtime::ModuleLoader &
+Runtime::ModuleLoader::AddNative(const std::string &name,
+                                 std::vector<std::string> exports,
+                                 NativeModule::Init init) {
+  return AddNative(name, {std::move(exports), std::move(init)});
+}
+
+Runtime::ModuleLoader &
+Runtime::ModuleLoader::AddNative(const std::string &name, NativeModule module) {
+  NativeModules[name] = std::move(module);
+  return *this;
+}
+
 // It would be nice if there would be a native TS implementation inside C++
 Runtime::Runtime() {
   m_Logger = CreateRef<Logger>();
+#ifdef VQJS_DSP
+  m_ModuleLoader.AddNative("vqjs:dsp", {.Create = &DSP::CreateModule});
+#endif
   JS_SetRuntimeOpaque(m_CompilationInstance.m_Context, this);
   PrepareStd(m_CompilationInstance.m_Context, true);
 }
 
+// workers use the loader and logger until they are joined
+Runtime::~Runtime() { m_AppInstance.TerminateWorkers(); }
+
+static int StripFlags(const Runtime::Config &config) {
+  if (!config.Strip)
+    return 0;
+  return config.KeepLineInfo ? JS_STRIP_SOURCE
+                             : JS_STRIP_SOURCE | JS_STRIP_DEBUG;
+}
+
 bool Runtime::Start() {
+  // typescript.js is the largest script by far
+  JS_SetStripInfo(m_CompilationInstance.m_Context, StripFlags(m_Config));
   if (m_Config.UseTypescript) {
     m_CompilationInstance.SetStackSize(0);
     m_CompilationInstance.SetBaseDirectory(m_Config.CoreDirectory);
@@ -136,14 +229,63 @@ bool Runtime::Start() {
   return Reset();
 }
 
-bool Runtime::Reset() {
-  m_AppInstance.Reset();
-  JS_SetRuntimeOpaque(m_AppInstance.m_Context, this);
-  PrepareStd(m_AppInstance.m_Context, false);
-  JS_SetModuleLoaderFunc(m_AppInstance.m_Context, nullptr, &Loader::LoadModule,
+// config is a copy on other threads, m_Config belongs to the main one
+void Runtime::PrepareApp(Instance &instance, const Config &config) {
+  JS_SetRuntimeOpaque(instance.m_Context, this);
+  JS_SetStripInfo(instance.m_Context, StripFlags(config));
+  PrepareStd(instance.m_Context, false);
+  JS_SetModuleLoaderFunc(instance.m_Context, nullptr, &Loader::LoadModule,
                          this);
+  Worker::Install(instance);
+}
+
+Ref<Instance> Runtime::CreateIsolatedInstance(const std::string &name,
+                                              const bool privateHeap) {
+  return CreateIsolatedInstance(name, privateHeap,
+                                m_AppInstance.m_BaseDirectory, m_Config);
+}
+
+Ref<Instance>
+Runtime::CreateIsolatedInstance(const std::string &name, const bool privateHeap,
+                                const std::string &baseDirectory,
+                                const Config &config) {
+  auto instance = CreateRef<Instance>(name, privateHeap);
+  instance->SetBaseDirectory(baseDirectory);
+  PrepareApp(*instance, config);
+  return instance;
+}
+
+bool Runtime::Reset() {
+  Ref<Instance> standby = m_Standby.valid() ? m_Standby.get() : nullptr;
+  // built with an older config, it would miss the changes
+  if (standby && m_StandbyStrip != StripFlags(m_Config))
+    standby = nullptr;
+  if (standby) {
+    // the old state goes away with the standby instance
+    m_AppInstance.Swap(*standby);
+    // the runtime got created on the other thread
+    JS_UpdateStackTop(m_AppInstance.m_Context);
+  } else {
+    m_AppInstance.Reset();
+    PrepareApp(m_AppInstance, m_Config);
+  }
   if (m_ModuleLoader.Paths.contains("@"))
     m_AppInstance.SetBaseDirectory(m_ModuleLoader.Paths["@"]);
+  if (m_Config.PrewarmReset) {
+    m_StandbyStrip = StripFlags(m_Config);
+    m_Standby = std::async(std::launch::async,
+                           [this, name = m_AppInstance.m_Name,
+                            base = m_AppInstance.m_BaseDirectory,
+                            config = m_Config] {
+                             // no private heap, it would belong to the
+                             // standby thread
+                             return CreateIsolatedInstance(name, false, base,
+                                                           config);
+                           });
+  }
+  // shipped builds don't transpile anything
+  if (m_Bundle)
+    return true;
   for (auto &path : m_ModuleLoader.Paths) {
     if (!File::Exists(path.second + ".cache/")) {
       File::CreateDirectory(path.second + ".cache/");
@@ -152,9 +294,61 @@ bool Runtime::Reset() {
   return true;
 }
 
+Ref<Instance> Runtime::CreateInstance(const std::string &name) {
+  auto instance = CreateRef<Instance>(name, m_AppInstance);
+  PrepareStd(instance->m_Context, false);
+  Worker::Install(*instance);
+  return instance;
+}
+
 Instance &Runtime::GetInstance() { return m_AppInstance; }
 Instance &Runtime::GetCompilerInstance() { return m_CompilationInstance; }
 
+bool Runtime::LoadBundle(const std::string &file) {
+  auto bundle = CreateRef<Bundle>();
+  if (!bundle->Open(file)) {
+    m_Logger->Error("Failed to load bundle " + file);
+    return false;
+  }
+  if (m_Config.Strip && !(bundle->Flags() & Bundle::StripSource))
+    m_Logger->Warn("Bundle " + file + " contains the sources");
+  m_Bundle = bundle;
+  return true;
+}
+
+bool Runtime::WriteBundle(const std::string &file,
+                          const std::vector<std::string> &entries) {
+  BundleWriter writer;
+  m_Recording = &writer;
+  bool success = true;
+  for (const auto &entry : entries) {
+    // compiling and resolving pulls in the imports through the loader
+    const Value module = LoadFile(entry, false);
+    JSContext *ctx = m_AppInstance.m_Context;
+    if (module.IsException() ||
+        JS_ResolveModule(ctx, Utils::ToJSValue(module.m_UnderlyingValue)) <
+            0) {
+      // failed imports are logged by the loader already
+      JS_FreeValue(ctx, JS_GetException(ctx));
+      m_Logger->Error("Failed to bundle " + entry);
+      success = false;
+      break;
+    }
+  }
+  m_Recording = nullptr;
+  const int strip = StripFlags(m_Config);
+  uint32_t flags = 0;
+  if (strip & JS_STRIP_SOURCE)
+    flags |= Bundle::StripSource;
+  if (strip & JS_STRIP_DEBUG)
+    flags |= Bundle::StripDebug;
+  if (success && !writer.Write(file, flags)) {
+    m_Logger->Error("Failed to write bundle " + file);
+    success = false;
+  }
+  return success;
+}
+
 void Runtime::SetIncludeDirectory(const std::string &includeDir) {
   m_AppInstance.SetBaseDirectory(includeDir);
 }
@@ -190,12 +384,14 @@ std::string Runtime::TranspileFile(const std::string &file) const {
     return file;
 
   // okay now we are in a TS scope ;)
+  std::lock_guard lock(m_CompileMutex);
   const Value _ = m_CompilationInstance.Global();
   _["compile"](_.String(fullPath), _.String(cacheFile));
   return cacheFile;
 }
 
 void Runtime::WriteTSConfig() const {
+  std::lock_guard lock(m_CompileMutex);
   auto global = m_CompilationInstance.Global();
   auto fileObj = global.Object();
   for (const auto &[fst, snd] : m_ModuleLoader.Paths) {
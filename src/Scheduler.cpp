@@ -0,0 +1,217 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <exception>
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+// Lets Post from inside a task use the queue of the running thread
+static thread_local const Scheduler *CurrentScheduler = nullptr;
+static thread_local size_t CurrentIndex = 0;
+
+Scheduler::Scheduler(size_t threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  m_Queues.reserve(threads);
+  for (size_t i = 0; i < threads; i++)
+    m_Queues.push_back(std::make_unique<Queue>());
+  m_Threads.reserve(threads);
+  for (size_t i = 0; i < threads; i++)
+    m_Threads.emplace_back(&Scheduler::Loop, this, i);
+}
+
+Scheduler::~Scheduler() {
+  Wait();
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Wake.notify_all();
+  for (auto &thread : m_Threads)
+    thread.join();
+}
+
+void Scheduler::Post(const Ref<Instance> &instance, Task task) {
+  const Instance *owner = instance->m_Owner;
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Pending++;
+  }
+  Ref<Strand> strand;
+  bool schedule = false;
+  {
+    std::lock_guard lock(m_StrandMutex);
+    auto &entry = m_Strands[owner];
+    if (!entry) {
+      entry = CreateRef<Strand>();
+      entry->Owner = owner;
+    }
+    strand = entry;
+    std::lock_guard strandLock(strand->Mutex);
+    strand->Tasks.emplace_back(instance, std::move(task));
+    if (!strand->Queued) {
+      strand->Queued = true;
+      schedule = true;
+    }
+  }
+  if (schedule)
+    Schedule(strand);
+}
+
+Scheduler::FrameResult
+Scheduler::Frame(const std::vector<Ref<Instance>> &instances, const Task &task,
+                 const Clock::time_point deadline) {
+  struct State {
+    std::mutex Mutex;
+    std::condition_variable Done;
+    size_t Remaining{0};
+    FrameResult Result{};
+  };
+  if (CurrentScheduler == this) {
+    // the strand of the calling task is busy until it returns
+    FrameResult result;
+    result.Skipped = instances.size();
+    result.Late = Clock::now() > deadline;
+    return result;
+  }
+  const auto state = CreateRef<State>();
+  state->Remaining = instances.size();
+  for (const auto &instance : instances) {
+    Post(instance, [state, &task, deadline](Instance &self) {
+      const bool skip = Clock::now() > deadline;
+      std::exception_ptr error;
+      if (!skip) {
+        try {
+          task(self);
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+      {
+        std::lock_guard lock(state->Mutex);
+        if (skip)
+          state->Result.Skipped++;
+        else if (error)
+          state->Result.Failed++;
+        else
+          state->Result.Completed++;
+        if (--state->Remaining == 0)
+          state->Done.notify_all();
+      }
+      // Run counts it
+      if (error)
+        std::rethrow_exception(error);
+    });
+  }
+  std::unique_lock lock(state->Mutex);
+  state->Done.wait(lock, [&state] { return state->Remaining == 0; });
+  state->Result.Late = Clock::now() > deadline;
+  return state->Result;
+}
+
+void Scheduler::Wait() {
+  std::unique_lock lock(m_Mutex);
+  m_Idle.wait(lock, [this] { return m_Pending == 0; });
+}
+
+void Scheduler::Schedule(const Ref<Strand> &strand) {
+  const size_t index = CurrentScheduler == this
+                           ? CurrentIndex
+                           : m_Next.fetch_add(1, std::memory_order_relaxed) %
+                                 m_Queues.size();
+  {
+    std::lock_guard lock(m_Queues[index]->Mutex);
+    m_Queues[index]->Strands.push_back(strand);
+  }
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Ready++;
+  }
+  m_Wake.notify_one();
+}
+
+Ref<Scheduler::Strand> Scheduler::Next(const size_t index) {
+  // newest from the own queue, it's likely still in cache
+  {
+    auto &own = *m_Queues[index];
+    std::lock_guard lock(own.Mutex);
+    if (!own.Strands.empty()) {
+      auto strand = std::move(own.Strands.back());
+      own.Strands.pop_back();
+      return strand;
+    }
+  }
+  // oldest from the others
+  for (size_t i = 1; i < m_Queues.size(); i++) {
+    auto &other = *m_Queues[(index + i) % m_Queues.size()];
+    std::lock_guard lock(other.Mutex);
+    if (!other.Strands.empty()) {
+      auto strand = std::move(other.Strands.front());
+      other.Strands.pop_front();
+      return strand;
+    }
+  }
+  return nullptr;
+}
+
+void Scheduler::Run(const Ref<Strand> &strand) {
+  // only what was queued so far, new tasks go to the back of the line
+  std::deque<std::pair<Ref<Instance>, Task>> tasks;
+  {
+    std::lock_guard lock(strand->Mutex);
+    tasks.swap(strand->Tasks);
+  }
+  if (!tasks.empty()) {
+    // the runtime might have been used by another thread before
+    JS_UpdateStackTop(tasks.front().first->GetContext());
+  }
+  for (auto &[instance, task] : tasks) {
+    try {
+      task(*instance);
+    } catch (...) {
+      m_Failed.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  const size_t done = tasks.size();
+  // might drop the last reference to an instance, the strand is still ours
+  tasks.clear();
+
+  bool again = false;
+  {
+    std::lock_guard lock(m_StrandMutex);
+    std::lock_guard strandLock(strand->Mutex);
+    again = !strand->Tasks.empty();
+    if (!again) {
+      strand->Queued = false;
+      m_Strands.erase(strand->Owner);
+    }
+  }
+  if (again)
+    Schedule(strand);
+
+  std::lock_guard lock(m_Mutex);
+  m_Pending -= done;
+  if (m_Pending == 0)
+    m_Idle.notify_all();
+}
+
+void Scheduler::Loop(const size_t index) {
+  CurrentScheduler = this;
+  CurrentIndex = index;
+  while (true) {
+    {
+      std::unique_lock lock(m_Mutex);
+      m_Wake.wait(lock, [this] { return m_Stop || m_Ready > 0; });
+      if (m_Ready == 0)
+        return;
+      m_Ready--;
+    }
+    // every m_Ready is one queued strand, so this finds one eventually
+    Ref<Strand> strand;
+    while (!(strand = Next(index)))
+      std::this_thread::yield();
+    Run(strand);
+  }
+}
+} // namespace VQJS
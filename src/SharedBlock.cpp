@@ -0,0 +1,104 @@
+#include "SharedBlock.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace VQJS {
+
+static std::string Index(const SharedLayout::Field &field,
+                         const bool buffered) {
+  if (!buffered)
+    return std::to_string(field.Offset / field.ElementSize);
+  const std::string byte = "base + " + std::to_string(field.Offset);
+  if (field.ElementSize == 1)
+    return byte;
+  return "(" + byte + ") >> " +
+         std::to_string(std::countr_zero(field.ElementSize));
+}
+
+std::string SharedLayout::Source(const std::vector<Field> &fields,
+                                 const size_t stride) {
+  const bool buffered = stride > 0;
+  std::vector<std::string> views;
+  const auto view = [&views](const Field &field) {
+    const auto found = std::ranges::find(views, field.View);
+    return "v" + std::to_string(found - views.begin());
+  };
+  for (const auto &field : fields) {
+    if (field.Count == 0 && std::ranges::find(views, field.View) == views.end())
+      views.emplace_back(field.View);
+  }
+
+  std::string js = "(function (buffer) {\n";
+  for (size_t i = 0; i < views.size(); i++) {
+    js += "  const v" + std::to_string(i) + " = new " + views[i] +
+          "(buffer);\n";
+  }
+  if (buffered) {
+    js += "  const state = new Int32Array(buffer, 0, 1);\n";
+    js += "  const offsets = [";
+    for (size_t i = 0; i < 3; i++) {
+      js += std::to_string(HeaderSize + i * stride) + (i < 2 ? ", " : "");
+    }
+    js += "];\n  let front = 0;\n  let base = offsets[0];\n";
+  }
+  for (size_t i = 0; i < fields.size(); i++) {
+    const Field &field = fields[i];
+    if (field.Count == 0 || !buffered)
+      continue;
+    // one view per copy, update only switches between them
+    js += "  const a" + std::to_string(i) + " = offsets.map((o) => new " +
+          field.View + "(buffer, o + " + std::to_string(field.Offset) + ", " +
+          std::to_string(field.Count) + "));\n";
+  }
+
+  js += "  return {\n";
+  if (buffered) {
+    js += "    update() {\n"
+          "      if ((Atomics.load(state, 0) & " +
+          std::to_string(Dirty) +
+          ") === 0) return false;\n"
+          "      front = Atomics.exchange(state, 0, front) & " +
+          std::to_string(IndexMask) +
+          ";\n"
+          "      base = offsets[front];\n"
+          "      return true;\n"
+          "    },\n";
+  }
+  for (size_t i = 0; i < fields.size(); i++) {
+    const Field &field = fields[i];
+    const std::string name = field.Name;
+    if (field.Count > 0) {
+      if (buffered) {
+        js += "    get " + name + "() { return a" + std::to_string(i) +
+              "[front]; },\n";
+      } else {
+        js += "    " + name + ": new " + field.View + "(buffer, " +
+              std::to_string(field.Offset) + ", " +
+              std::to_string(field.Count) + "),\n";
+      }
+      continue;
+    }
+    const std::string slot = view(field) + "[" + Index(field, buffered) + "]";
+    js += "    get " + name + "() { return " + slot +
+          (field.Bool ? " !== 0" : "") + "; },\n";
+    if (!buffered) {
+      js += "    set " + name + "(v) { " + slot + " = " +
+            (field.Bool ? "v ? 1 : 0" : "v") + "; },\n";
+    }
+  }
+  js += "  };\n})";
+  return js;
+}
+
+Value SharedLayout::Bind(const Value &context, const Value &buffer,
+                         const std::vector<Field> &fields,
+                         const size_t stride) {
+  // the script cache of the instance keeps the compiled factory around
+  const Value factory =
+      context.GetInstance()->Eval(Source(fields, stride), "<SharedBlock>");
+  if (factory.IsException())
+    return factory;
+  return factory(buffer);
+}
+} // namespace VQJS
@@ -1,8 +1,13 @@
+#include "BufferPool.h"
+#include "Json.h"
+#include "Recorder.h"
 #include "impl.h"
 #include "internals.h"
 #include "vqjs.h"
 
+#include <charconv>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <quickjs/quickjs.h>
 #include <random>
@@ -14,11 +19,6 @@ namespace VQJS {
 #define VNEW(obj)                                                              \
   Value { m_Context, Utils::FromJSValue(obj) }
 
-// SharedBuffers are always uint8_t ptr, so we can easily delete them :)
-static void DeallocateSharedBuffer(JSRuntime *, void *, void *ptr) {
-  delete[] static_cast<uint8_t *>(ptr);
-}
-
 Value Value::Global() const {
   return Value{m_Context, FROM(JS_GetGlobalObject(m_Context))};
 }
@@ -26,12 +26,28 @@ Value Value::New() const { return VNEW(JS_UNDEFINED); }
 Value Value::Undefined() const { return VNEW(JS_UNDEFINED); }
 Value Value::Object() const { return VNEW(JS_NewObject(m_Context)); }
 Value Value::NewArray() const { return VNEW(JS_NewArray(m_Context)); }
+Value Value::FromJSON(const std::string_view json) const {
+  return Json::Parse(*this, json);
+}
+
+// The runtime's SharedArrayBuffer hooks (see Context.cpp) retain pool
+// buffers when they get wrapped and release them on finalize, the free_func
+// is never called for shared buffers.
+Value Value::SharedArrayBuffer(const size_t bytes, const bool zeroed) const {
+  auto *buffer = BufferPool::Get().Allocate(bytes, zeroed);
+  if (!buffer)
+    return VNEW(JS_ThrowOutOfMemory(m_Context));
+  const JSValue val =
+      JS_NewArrayBuffer(m_Context, buffer, bytes, nullptr, nullptr, true);
+  // the buffer holds its own reference now
+  BufferPool::Get().Release(buffer);
+  return VNEW(val);
+}
 
-Value Value::SharedArrayBuffer(const size_t bytes) const {
-  // we always creating shared Buffers here...
-  auto *buffer = new uint8_t[bytes / sizeof(uint8_t)];
-  const JSValue val = JS_NewArrayBuffer(m_Context, buffer, bytes,
-                                        &DeallocateSharedBuffer, nullptr, true);
+Value Value::PooledSharedArrayBuffer(uint8_t *buffer,
+                                     const size_t bytes) const {
+  const JSValue val =
+      JS_NewArrayBuffer(m_Context, buffer, bytes, nullptr, nullptr, true);
   return VNEW(val);
 }
 
@@ -41,14 +57,55 @@ Value Value::SharedArrayBuffer(uint8_t *buf, const size_t bytes) const {
   return VNEW(val);
 }
 
+BorrowedString::~BorrowedString() {
+  if (m_Ctx)
+    JS_FreeCString(m_Ctx, m_Data);
+}
+
+BorrowedString::BorrowedString(BorrowedString &&other) noexcept
+    : m_Ctx(other.m_Ctx), m_Data(other.m_Data), m_Size(other.m_Size) {
+  if (other.m_Data == other.m_Inline) {
+    std::memcpy(m_Inline, other.m_Inline, sizeof(m_Inline));
+    m_Data = m_Inline;
+  }
+  other.m_Ctx = nullptr;
+  other.m_Data = nullptr;
+  other.m_Size = 0;
+}
+
+BorrowedString Value::Borrow() const {
+  BorrowedString str;
+  const JSValue val = TO(m_UnderlyingValue);
+  switch (JS_VALUE_GET_TAG(val)) {
+  case JS_TAG_INT: {
+    const auto end = std::to_chars(str.m_Inline,
+                                   str.m_Inline + sizeof(str.m_Inline),
+                                   JS_VALUE_GET_INT(val))
+                         .ptr;
+    str.m_Data = str.m_Inline;
+    str.m_Size = end - str.m_Inline;
+    return str;
+  }
+  case JS_TAG_BOOL:
+    str.m_Data = JS_VALUE_GET_BOOL(val) ? "true" : "false";
+    break;
+  case JS_TAG_NULL: str.m_Data = "null"; break;
+  case JS_TAG_UNDEFINED: str.m_Data = "undefined"; break;
+  default:
+    str.m_Data = JS_ToCStringLen(m_Context, &str.m_Size, val);
+    str.m_Ctx = str.m_Data ? static_cast<JSContext *>(m_Context) : nullptr;
+    return str;
+  }
+  str.m_Size = std::strlen(str.m_Data);
+  return str;
+}
+
 std::string Value::AsString() const {
-  const char *str = JS_ToCString(m_Context, TO(m_UnderlyingValue));
-  if (str == nullptr) {
+  const auto str = Borrow();
+  if (!str) {
     return "null";
   }
-  std::string result(str);
-  JS_FreeCString(m_Context, str);
-  return result;
+  return std::string{str.View()};
 }
 // Hack return because its faster... and if the value is wrong the Engine will
 // not like it anyway
@@ -89,18 +146,19 @@ Value Value::Exception() const {
   return Value(m_Context, FROM(JS_GetException(m_Context)));
 }
 std::string Value::ExceptionStack() const {
-  auto val = JS_GetPropertyStr(m_Context, TO(m_UnderlyingValue), "stack");
-  const char *str = JS_ToCString(m_Context, val);
-  JS_FreeValue(m_Context, val);
+  const Value stack{
+      m_Context,
+      FROM(JS_GetPropertyStr(m_Context, TO(m_UnderlyingValue), "stack"))};
+  const auto str = stack.Borrow();
   if (!str) {
     return "<null>";
   }
-  std::string result = str;
-  JS_FreeCString(m_Context, str);
-  return result;
+  return std::string{str.View()};
 }
 Value Value::Get(const std::string &key) const { return (*this)[key]; }
 Value Value::Call(const std::vector<Value> &args) const {
+  if (const auto *instance = GetInstance(); instance && instance->m_Recorder)
+    instance->m_Recorder->Call(*this, args);
   const auto globalVal = Global();
   std::vector<JSValue> jsValues;
   jsValues.reserve(args.size());
@@ -113,6 +171,8 @@ Value Value::Call(const std::vector<Value> &args) const {
 }
 
 Value Value::CallBind(const Value &bind, const std::vector<Value> &args) const {
+  if (const auto *instance = GetInstance(); instance && instance->m_Recorder)
+    instance->m_Recorder->Call(*this, args);
   const auto globalVal = Global();
   std::vector<JSValue> jsValues;
   jsValues.reserve(args.size());
@@ -152,13 +212,48 @@ std::vector<std::string> Value::ObjectKeys() const {
 }
 
 RawArray<void> Value::ToRawTypedArray() const {
+  size_t byteOffset = 0;
   size_t bytesPerElement = 0;
   size_t byteLengths = 0;
-  JSValue dataPtr =
-      JS_GetTypedArrayBuffer(m_Context, TO(m_UnderlyingValue), nullptr,
+  const JSValue buffer =
+      JS_GetTypedArrayBuffer(m_Context, TO(m_UnderlyingValue), &byteOffset,
                              &byteLengths, &bytesPerElement);
+  if (JS_IsException(buffer)) {
+    JS_FreeValue(m_Context, JS_GetException(m_Context));
+    return {};
+  }
+  size_t size = 0;
+  uint8_t *data = JS_GetArrayBuffer(m_Context, &size, buffer);
+  JS_FreeValue(m_Context, buffer);
+  if (!data)
+    return {};
+  return {data + byteOffset, byteLengths / bytesPerElement};
+}
 
-  return {dataPtr.u.ptr, byteLengths / bytesPerElement};
+int Value::TypedArrayType() const {
+  const int type = JS_GetTypedArrayType(TO(m_UnderlyingValue));
+  return type == JS_TYPED_ARRAY_UINT8C ? JS_TYPED_ARRAY_UINT8 : type;
+}
+
+int Value::TypedArrayTypeOf(const size_t elementSize, const bool floating,
+                            const bool isSigned) {
+  if (floating) {
+    return elementSize == 4   ? JS_TYPED_ARRAY_FLOAT32
+           : elementSize == 8 ? JS_TYPED_ARRAY_FLOAT64
+                              : -1;
+  }
+  switch (elementSize) {
+  case 1:
+    return isSigned ? JS_TYPED_ARRAY_INT8 : JS_TYPED_ARRAY_UINT8;
+  case 2:
+    return isSigned ? JS_TYPED_ARRAY_INT16 : JS_TYPED_ARRAY_UINT16;
+  case 4:
+    return isSigned ? JS_TYPED_ARRAY_INT32 : JS_TYPED_ARRAY_UINT32;
+  case 8:
+    return isSigned ? JS_TYPED_ARRAY_BIG_INT64 : JS_TYPED_ARRAY_BIG_UINT64;
+  default:
+    return -1;
+  }
 }
 
 RawArray<void> Value::ToSharedArrayBuffer() const {
@@ -219,9 +314,17 @@ struct ValueUtils {
     JS_FreeCString(ctx, str);
 
     if (fncPtr != nullptr) {
+      Recorder *recorder = instancePtr->m_Recorder.get();
+      if (recorder)
+        recorder->m_Depth++;
       const Value val =
           fncPtr->Function(Value::FromCtx(fncPtr->Ctx, &this_val),
                            ConvertToValueCall(fncPtr->Ctx, argv, argc));
+      if (recorder) {
+        recorder->m_Depth--;
+        if (!fncPtr->Recorded.empty())
+          recorder->Result(fncPtr->Recorded, val);
+      }
       return JS_DupValue(ctx, TO(val.m_UnderlyingValue));
     }
     return JS_UNDEFINED;
@@ -253,6 +356,16 @@ void Value::AddFunction(const std::string &name, const Func &func,
       CreateRef<FunctionData>(FunctionData{m_Context, func});
   std::string hash = random_string(16) + name;
   instancePtr->m_Functions[hash] = funcRef;
+  if (instancePtr->m_Recorder) {
+    // only global ones, the replay can't rebuild other objects
+    const JSValue global = JS_GetGlobalObject(m_Context);
+    if (JS_VALUE_GET_PTR(global) ==
+        JS_VALUE_GET_PTR(TO(m_UnderlyingValue))) {
+      funcRef->Recorded = name;
+      instancePtr->m_Recorder->Native(name);
+    }
+    JS_FreeValue(m_Context, global);
+  }
 
   JSValue fncData = JS_NewString(m_Context, hash.c_str());
   const std::string nameFncData = "__fncData" + name;
@@ -268,8 +381,8 @@ Value Value::ThrowException(const std::string &message) const {
   return VNEW(JS_Throw(m_Context, JS_NewString(m_Context, message.c_str())));
 }
 
-Value Value::String(const std::string &data) const {
-  return VNEW(JS_NewString(m_Context, data.c_str()));
+Value Value::String(const std::string_view data) const {
+  return VNEW(JS_NewStringLen(m_Context, data.data(), data.size()));
 }
 
 Value Value::Boolean(bool value) const {
@@ -288,6 +401,10 @@ Runtime *Value::GetRuntime() const {
   return static_cast<Runtime *>(JS_GetRuntimeOpaque(JS_GetRuntime(m_Context)));
 }
 
+Instance *Value::GetInstance() const {
+  return static_cast<Instance *>(JS_GetContextOpaque(m_Context));
+}
+
 Value Value::FromCtx(const Context &ctx, JSValue *val) {
   return Value{ctx, FROM(JS_DupValue(ctx, *val))};
 }
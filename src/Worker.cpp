@@ -0,0 +1,269 @@
+#include "Worker.h"
+#include "BufferPool.h"
+#include "ClassBinding.h"
+#include "impl.h"
+
+#include <algorithm>
+#include <quickjs/quickjs.h>
+
+namespace VQJS {
+
+#define FROM(obj) Utils::FromJSValue(obj)
+#define TO(obj) Utils::ToJSValue(obj)
+
+Message::Message(Message &&other) noexcept
+    : m_Data(std::move(other.m_Data)), m_Shared(std::move(other.m_Shared)) {
+  other.m_Shared.clear();
+}
+
+Message &Message::operator=(Message &&other) noexcept {
+  if (&other == this)
+    return *this;
+  for (auto *buffer : m_Shared)
+    BufferPool::Get().Release(buffer);
+  m_Data = std::move(other.m_Data);
+  m_Shared = std::move(other.m_Shared);
+  other.m_Shared.clear();
+  return *this;
+}
+
+Message::~Message() {
+  for (auto *buffer : m_Shared)
+    BufferPool::Get().Release(buffer);
+}
+
+Value Message::Write(const Value &value, const Value &transfer, Message &out) {
+  JSContext *ctx = value.m_Context;
+  size_t size = 0;
+  JSSABTab tab{nullptr, 0};
+  uint8_t *data = JS_WriteObject2(ctx, &size, TO(value.m_UnderlyingValue),
+                                  JS_WRITE_OBJ_SAB | JS_WRITE_OBJ_REFERENCE,
+                                  &tab);
+  if (!data)
+    return Value{value.m_Context, FROM(JS_EXCEPTION)};
+  out.m_Data.assign(data, data + size);
+  js_free(ctx, data);
+  // foreign memory (Value::SharedArrayBuffer(buf, n)) is owned by native
+  // code, which has to keep it alive as long as the message
+  for (size_t i = 0; i < tab.len; i++) {
+    if (!BufferPool::Get().Owns(tab.tab[i]))
+      continue;
+    BufferPool::Get().Retain(tab.tab[i]);
+    out.m_Shared.push_back(tab.tab[i]);
+  }
+  js_free(ctx, tab.tab);
+
+  // QuickJS can't hand the storage of a plain ArrayBuffer to another
+  // runtime, so it got copied above and is only detached here
+  if (transfer.IsArray()) {
+    for (const auto &item : transfer.AsArray()) {
+      const JSValue buffer = TO(item.m_UnderlyingValue);
+      if (JS_IsArrayBuffer(buffer))
+        JS_DetachArrayBuffer(ctx, buffer);
+    }
+  }
+  return value.Undefined();
+}
+
+Value Message::Read(const Value &ctx) const {
+  const JSValue val =
+      JS_ReadObject(ctx.m_Context, m_Data.data(), m_Data.size(),
+                    JS_READ_OBJ_SAB | JS_READ_OBJ_REFERENCE);
+  return Value{ctx.m_Context, FROM(val)};
+}
+
+static void Deliver(const Value &handler, const Message &message,
+                    Logger &logger) {
+  if (!handler.IsFunction())
+    return;
+  const Value data = message.Read(handler);
+  if (data.IsException()) {
+    logger.Error(data.Exception().AsString());
+    return;
+  }
+  const Value event = handler.Object();
+  event.Set("data", data);
+  const Value result = handler(event);
+  if (result.IsException())
+    logger.Error(result.Exception().AsString());
+}
+
+static void RunJobs(Instance &instance, Logger &logger) {
+  const Context &context = instance.GetContext();
+  JSContext *ctx = nullptr;
+  int ret;
+  while ((ret = JS_ExecutePendingJob(context, &ctx)) != 0) {
+    if (ret < 0) {
+      JSValue error = JS_GetException(ctx);
+      logger.Error(Value::FromCtx(context, &error).AsString());
+      JS_FreeValue(ctx, error);
+    }
+  }
+}
+
+static int Interrupted(JSRuntime *, void *opaque) {
+  return !static_cast<Worker *>(opaque)->IsRunning();
+}
+
+Worker::Worker(Runtime &runtime, std::string file, std::string baseDirectory)
+    : m_Runtime(runtime),
+      m_File(std::move(file)),
+      m_BaseDirectory(std::move(baseDirectory)),
+      m_Config(runtime.GetConfig()) {
+  m_Thread = std::thread(&Worker::Run, this);
+}
+
+Worker::~Worker() { Terminate(); }
+
+void Worker::Post(Message message) {
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Inbox.push_back(std::move(message));
+  }
+  m_Wake.notify_one();
+}
+
+void Worker::Join() {
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Running = false;
+  }
+  m_Wake.notify_one();
+  if (m_Thread.joinable() && m_Thread.get_id() != std::this_thread::get_id())
+    m_Thread.join();
+}
+
+void Worker::Terminate() {
+  Join();
+  // the handler might reference the worker object, don't keep it alive
+  m_OnMessage = Value{};
+}
+
+bool Worker::IsRunning() const { return m_Running; }
+
+void Worker::Run() {
+  const auto instance = m_Runtime.CreateIsolatedInstance(
+      "Worker " + m_File, true, m_BaseDirectory, m_Config);
+  Logger &logger = m_Runtime.GetLogger();
+  const Context &context = instance->GetContext();
+  JS_SetCanBlock(context, true);
+  JS_SetInterruptHandler(context, &Interrupted, this);
+
+  Value global = instance->Global();
+  global.Set("self", global);
+  global.Set("onmessage", global.Undefined());
+  // nobody would poll nested ones
+  global.Set("Worker", global.Undefined());
+  global.AddFunction(
+      "postMessage",
+      [this](const Value &_, const std::vector<Value> &args) {
+        if (args.empty())
+          return _.ThrowException("No message provided");
+        Message message;
+        const Value written = Message::Write(
+            args[0], args.size() > 1 ? args[1] : _.Undefined(), message);
+        if (written.IsException())
+          return written;
+        std::lock_guard lock(m_Mutex);
+        m_Outbox.push_back(std::move(message));
+        return _.Undefined();
+      },
+      2);
+  global.AddFunction("close",
+                     [this](const Value &_, const std::vector<Value> &) {
+                       m_Running = false;
+                       return _.Undefined();
+                     });
+
+  // errors are logged by LoadFile already
+  if (instance->LoadFile(m_File, ModuleType::Module).IsException())
+    m_Running = false;
+  RunJobs(*instance, logger);
+
+  while (m_Running) {
+    std::deque<Message> inbox;
+    {
+      std::unique_lock lock(m_Mutex);
+      m_Wake.wait(lock, [this] { return !m_Inbox.empty() || !m_Running; });
+      inbox.swap(m_Inbox);
+    }
+    const Value handler = global["onmessage"];
+    for (const auto &message : inbox) {
+      if (!m_Running)
+        break;
+      Deliver(handler, message, logger);
+      RunJobs(*instance, logger);
+    }
+  }
+}
+
+size_t Worker::Dispatch() {
+  std::deque<Message> outbox;
+  {
+    std::lock_guard lock(m_Mutex);
+    outbox.swap(m_Outbox);
+  }
+  const Value handler = m_OnMessage;
+  for (const auto &message : outbox)
+    Deliver(handler, message, m_Runtime.GetLogger());
+  return outbox.size();
+}
+
+Value Worker::Constructor(Instance &instance) {
+  static const ClassBinding<Worker> binding = [] {
+    ClassBinding<Worker> worker("Worker");
+    worker
+        .SetConstructor([](const Value &_, const std::vector<Value> &args) {
+          if (args.empty() || !args[0].IsString()) {
+            (void)_.ThrowException("Worker needs a module path");
+            return Ref<Worker>{};
+          }
+          // relative to the creating instance, read here and not on the
+          // worker thread (the config as well)
+          auto *instance = _.GetInstance();
+          auto created = CreateRef<Worker>(*_.GetRuntime(), args[0].AsString(),
+                                           instance->m_BaseDirectory);
+          instance->m_Workers.push_back(created);
+          return created;
+        })
+        .AddMethod(
+            "postMessage",
+            [](Worker &self, const Value &_, const std::vector<Value> &args) {
+              if (args.empty())
+                return _.ThrowException("No message provided");
+              Message message;
+              const Value written = Message::Write(
+                  args[0], args.size() > 1 ? args[1] : _.Undefined(), message);
+              if (written.IsException())
+                return written;
+              self.Post(std::move(message));
+              return _.Undefined();
+            },
+            2)
+        .AddMethod("terminate",
+                   [](Worker &self, const Value &_,
+                      const std::vector<Value> &) {
+                     self.Terminate();
+                     return _.Undefined();
+                   })
+        .AddProperty(
+            "onmessage",
+            [](Worker &self, const Value &_) {
+              return self.m_OnMessage.IsFunction() ? self.m_OnMessage
+                                                   : _.Undefined();
+            },
+            [](Worker &self, const Value &, const Value &value) {
+              self.m_OnMessage = value;
+            });
+    return worker;
+  }();
+  return binding.Constructor(instance);
+}
+
+void Worker::Install(Instance &instance) {
+  instance.Global().Set("Worker", Constructor(instance));
+}
+
+#undef FROM
+#undef TO
+} // namespace VQJS
@@ -1,3 +1,4 @@
+#include "RingBuffer.h"
 #include "vqjs.h"
 
 #include <iostream>
@@ -7,6 +8,13 @@ auto main(const int argc, char *argv[]) -> int {
   }
   VQJS::Runtime runtime;
   runtime.GetLoader().Add("@core", "./app-core/").Add("@", "./app/");
+  // the audio thread writes left/right, scripts read(left, right) per frame
+  auto audio = VQJS::CreateRef<VQJS::RingBuffer<double>>(2048, 2);
+  // only created once a script does: import {audio} from "native:v3d"
+  runtime.GetLoader().AddNative(
+      "native:v3d", {"audio"}, [audio](const VQJS::Value &exports) {
+        exports.Set("audio", VQJS::RingBuffer<double>::Bind(audio, exports));
+      });
   VQJS::Instance &instance = runtime.GetInstance();
   runtime.Start();
   runtime.WriteTSConfig();
@@ -18,14 +26,6 @@ auto main(const int argc, char *argv[]) -> int {
         return val.New();
       });
 
-  auto global = instance.Global();
-  auto v3d = global.Object();
-  global.Set("v3d", v3d);
-  auto v3dAudio = global.Object();
-  v3d.Set("audio", v3dAudio);
-  v3dAudio.Set("left", global.TSharedArrayBuffer<double>(512));
-  v3dAudio.Set("right", global.TSharedArrayBuffer<double>(512));
-
   VQJS::Value main = runtime.LoadFile("test.ts");
   if (main.IsException()) {
     std::cout << "main failed: " << main.Exception().AsString() << "\n";
@@ -0,0 +1,41 @@
+#include "vqjs.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// vqjs-bundle [-c coreDir] [-p alias=dir]... out.vqjsb entry...
+// Compiles the entries and all their imports into one bundle file, load it
+// with Runtime::LoadBundle. Paths have to match the ones of the app.
+auto main(const int argc, char *argv[]) -> int {
+  VQJS::Runtime runtime;
+  std::vector<std::string> args{argv + 1, argv + argc};
+  std::vector<std::string> entries;
+  std::string output;
+  for (size_t i = 0; i < args.size(); i++) {
+    const bool hasValue = i + 1 < args.size();
+    if (args[i] == "-c" && hasValue) {
+      runtime.GetConfig().CoreDirectory = args[++i];
+    } else if (args[i] == "-p" && hasValue) {
+      const std::string &path = args[++i];
+      const size_t split = path.find('=');
+      if (split == std::string::npos) {
+        std::cerr << "invalid path " << path << ", expected alias=dir\n";
+        return 1;
+      }
+      runtime.GetLoader().Add(path.substr(0, split), path.substr(split + 1));
+    } else if (output.empty()) {
+      output = args[i];
+    } else {
+      entries.push_back(args[i]);
+    }
+  }
+  if (output.empty() || entries.empty()) {
+    std::cerr << "usage: vqjs-bundle [-c coreDir] [-p alias=dir]... "
+                 "out.vqjsb entry...\n";
+    return 1;
+  }
+  if (!runtime.Start() || !runtime.WriteBundle(output, entries))
+    return 1;
+  return 0;
+}
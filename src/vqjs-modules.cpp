@@ -4,17 +4,27 @@
 
 namespace VQJS {
 // Default Logger VQJS Logger
-void Logger::Info(const std::string &lines) const {
+void Logger::Info(const std::string &lines) {
   std::cout << "[VQJS][Info] >> " << lines << "\n";
 }
 
-void Logger::Debug(const std::string &lines) const {
+void Logger::Debug(const std::string &lines) {
   std::cout << "[VQJS][Debug] >> " << lines << "\n";
 }
-void Logger::Error(const std::string &lines) const {
+void Logger::Error(const std::string &lines) {
   std::cerr << "[VQJS][Error] >> " << lines << "\n";
 }
-void Logger::Warn(const std::string &lines) const {
+void Logger::Warn(const std::string &lines) {
   std::cout << "[VQJS][Warn] >> " << lines << "\n";
 }
+
+void Logger::Log(const Level level, const std::string_view line) {
+  const std::string lines{line};
+  switch (level) {
+  case Level::Debug: return Debug(lines);
+  case Level::Info: return Info(lines);
+  case Level::Warn: return Warn(lines);
+  case Level::Error: return Error(lines);
+  }
+}
 } // namespace VQJS
@@ -0,0 +1,210 @@
+#include "Recorder.h"
+#include "vqjs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <quickjs/quickjs.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// vqjs-replay [-c coreDir] [-p alias=dir]... [-b bundle] log entry
+// Loads entry like the app did, replaces the recorded native functions by
+// ones returning the recorded results and repeats the recorded calls.
+// Calls are looked up by name on the global object, calls of methods,
+// callbacks or anonymous functions can't be repeated and are reported.
+// Prints the time per frame (per call if no frames were recorded). Only the
+// calls and the jobs they queue are timed, their arguments are decoded
+// before.
+
+static size_t RunJobs(VQJS::Instance &instance) {
+  const VQJS::Context &context = instance.GetContext();
+  JSContext *ctx = nullptr;
+  size_t errors = 0;
+  int ret;
+  while ((ret = JS_ExecutePendingJob(context, &ctx)) != 0) {
+    if (ret < 0) {
+      JS_FreeValue(ctx, JS_GetException(ctx));
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static double Percentile(const std::vector<double> &sorted, const double p) {
+  if (sorted.empty())
+    return 0;
+  const auto index = static_cast<size_t>(p * (sorted.size() - 1));
+  return sorted[index];
+}
+
+auto main(const int argc, char *argv[]) -> int {
+  VQJS::Runtime runtime;
+  std::vector<std::string> args{argv + 1, argv + argc};
+  std::vector<std::string> positional;
+  for (size_t i = 0; i < args.size(); i++) {
+    const bool hasValue = i + 1 < args.size();
+    if (args[i] == "-c" && hasValue) {
+      runtime.GetConfig().CoreDirectory = args[++i];
+    } else if (args[i] == "-b" && hasValue) {
+      if (!runtime.LoadBundle(args[++i]))
+        return 1;
+      runtime.GetConfig().UseTypescript = false;
+    } else if (args[i] == "-p" && hasValue) {
+      const std::string &path = args[++i];
+      const size_t split = path.find('=');
+      if (split == std::string::npos) {
+        std::cerr << "invalid path " << path << ", expected alias=dir\n";
+        return 1;
+      }
+      runtime.GetLoader().Add(path.substr(0, split), path.substr(split + 1));
+    } else {
+      positional.push_back(args[i]);
+    }
+  }
+  if (positional.size() != 2) {
+    std::cerr << "usage: vqjs-replay [-c coreDir] [-p alias=dir]... "
+                 "[-b bundle] log entry\n";
+    return 1;
+  }
+
+  std::vector<VQJS::Recorder::Event> events;
+  if (!VQJS::Recorder::Read(positional[0], events)) {
+    std::cerr << "can't read " << positional[0] << "\n";
+    return 1;
+  }
+  if (!runtime.Start())
+    return 1;
+
+  VQJS::Instance &instance = runtime.GetInstance();
+  VQJS::Value global = instance.Global();
+  std::unordered_map<std::string, std::deque<const VQJS::Recorder::Event *>>
+      results;
+  std::unordered_set<std::string> natives;
+  bool hasFrames = false;
+  for (const auto &event : events) {
+    switch (event.Type) {
+    case VQJS::Recorder::Kind::Frame: hasFrames = true; break;
+    case VQJS::Recorder::Kind::Result:
+    case VQJS::Recorder::Kind::Throw:
+      results[event.Name].push_back(&event);
+      break;
+    case VQJS::Recorder::Kind::Native: natives.insert(event.Name); break;
+    case VQJS::Recorder::Kind::Call: break;
+    }
+  }
+  for (const auto &name : natives) {
+    global.AddFunction(
+        name,
+        [&results, name](const VQJS::Value &_,
+                         const std::vector<VQJS::Value> &) {
+          auto &queue = results[name];
+          if (queue.empty())
+            return _.Undefined();
+          const auto *event = queue.front();
+          queue.pop_front();
+          return VQJS::Recorder::Replay(_, *event);
+        });
+  }
+
+  const VQJS::Value main = runtime.LoadFile(positional[1]);
+  if (main.IsException())
+    return 1;
+  size_t errors = RunJobs(instance);
+
+  std::vector<double> times;
+  size_t calls = 0;
+  size_t missing = 0;
+  std::unordered_set<std::string> missingNames;
+  // the calls of one frame, or of one call without frames
+  std::vector<std::pair<const VQJS::Recorder::Event *,
+                        std::vector<VQJS::Value>>>
+      batch;
+  const auto run = [&](const bool timed) {
+    const auto start = Clock::now();
+    for (const auto &[event, callArgs] : batch) {
+      // at call time, a call before might have replaced it
+      const VQJS::Value function = global[event->Name];
+      if (!function.IsFunction()) {
+        missing++;
+        missingNames.insert(event->Name);
+        continue;
+      }
+      const VQJS::Value result = function.Call(callArgs);
+      if (result.IsException()) {
+        runtime.GetLogger().Error(result.Exception().AsString());
+        errors++;
+      }
+      errors += RunJobs(instance);
+      calls++;
+    }
+    if (timed) {
+      times.push_back(
+          std::chrono::duration<double, std::milli>(Clock::now() - start)
+              .count());
+    }
+    batch.clear();
+  };
+  // calls before the first frame run untimed
+  bool inFrame = false;
+  for (const auto &event : events) {
+    if (event.Type == VQJS::Recorder::Kind::Frame) {
+      run(inFrame);
+      inFrame = true;
+      continue;
+    }
+    if (event.Type != VQJS::Recorder::Kind::Call)
+      continue;
+    batch.emplace_back(&event,
+                       VQJS::Recorder::DecodeArgs(global, event.Data));
+    if (!hasFrames)
+      run(true);
+  }
+  run(inFrame);
+
+  size_t unused = 0;
+  for (const auto &queue : results)
+    unused += queue.second.size();
+  std::vector<double> sorted = times;
+  std::ranges::sort(sorted);
+  double total = 0;
+  for (const double time : times)
+    total += time;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "frames: " << times.size()
+            << (hasFrames ? "" : " (one per call)") << "\ncalls: " << calls
+            << " (" << missing << " missing, " << errors << " errors)\n"
+            << "unused native results: " << unused << "\n";
+  if (!missingNames.empty()) {
+    // methods, callbacks and anonymous functions end up here
+    std::cout << "not global functions:";
+    for (const auto &name : missingNames)
+      std::cout << " " << (name.empty() ? "(anonymous)" : name);
+    std::cout << "\n";
+  }
+  if (!times.empty()) {
+    std::cout << "total: " << total << "ms\n"
+              << "avg: " << total / times.size() << "ms\n"
+              << "p50: " << Percentile(sorted, 0.5) << "ms\n"
+              << "p95: " << Percentile(sorted, 0.95) << "ms\n"
+              << "p99: " << Percentile(sorted, 0.99) << "ms\n"
+              << "max: " << sorted.back() << "ms\n";
+    // worst frames, to find them in the recording again
+    std::vector<size_t> order(times.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    std::ranges::sort(order, [&times](const size_t a, const size_t b) {
+      return times[a] > times[b];
+    });
+    for (size_t i = 0; i < std::min<size_t>(5, order.size()); i++)
+      std::cout << "#" << order[i] << ": " << times[order[i]] << "ms\n";
+  }
+  return 0;
+}
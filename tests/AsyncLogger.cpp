@@ -0,0 +1,153 @@
+#include "AsyncLogger.h"
+#include "Check.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Keeps every line, Hold stops the logger thread inside Log
+struct Collector final : VQJS::Logger {
+  void Log(Level, const std::string_view line) override {
+    std::unique_lock lock(Mutex);
+    Entered = true;
+    Changed.notify_all();
+    Changed.wait(lock, [this] { return !Hold; });
+    Lines.emplace_back(line);
+  }
+  void Release() {
+    {
+      std::lock_guard lock(Mutex);
+      Hold = false;
+    }
+    Changed.notify_all();
+  }
+
+  std::mutex Mutex;
+  std::condition_variable Changed;
+  std::vector<std::string> Lines;
+  bool Hold{false};
+  bool Entered{false};
+};
+
+static std::string Pattern(const size_t size, const char seed) {
+  std::string line(size, ' ');
+  for (size_t i = 0; i < size; i++)
+    line[i] = static_cast<char>('a' + (seed + i) % 26);
+  return line;
+}
+
+int main() {
+  using VQJS::AsyncLogger;
+
+  // in order, and everything before Flush is written when it returns
+  {
+    const auto sink = VQJS::CreateRef<Collector>();
+    AsyncLogger logger(sink, 1h);
+    for (int i = 0; i < 1000; i++)
+      logger.Log(VQJS::Logger::Level::Info, "line " + std::to_string(i));
+    logger.Flush();
+    CHECK(sink->Lines.size() == 1000);
+    for (int i = 0; i < 1000; i++)
+      CHECK(sink->Lines[i] == "line " + std::to_string(i));
+    logger.MinLevel = VQJS::Logger::Level::Warn;
+    logger.Info("filtered");
+    logger.Error("kept");
+    logger.Flush();
+    CHECK(sink->Lines.size() == 1001 && sink->Lines.back() == "kept");
+    CHECK(logger.Dropped() == 0);
+  }
+
+  // long lines span slots and come back whole, past the limit they're cut
+  {
+    const auto sink = VQJS::CreateRef<Collector>();
+    AsyncLogger logger(sink);
+    const std::vector<std::string> lines{
+        "",
+        Pattern(AsyncLogger::SlotSize, 0),
+        Pattern(AsyncLogger::SlotSize + 1, 1),
+        "short",
+        Pattern(1000, 2),
+        Pattern(AsyncLogger::MaxLineSize, 3),
+        Pattern(AsyncLogger::MaxLineSize + 500, 4),
+        "end"};
+    // wraps around the ring a few times
+    for (int round = 0; round < 100; round++) {
+      for (const auto &line : lines)
+        logger.Log(VQJS::Logger::Level::Info, line);
+      logger.Flush();
+    }
+    CHECK(sink->Lines.size() == 100 * lines.size());
+    for (size_t i = 0; i < sink->Lines.size(); i++) {
+      const auto &line = lines[i % lines.size()];
+      CHECK(sink->Lines[i] == line.substr(0, AsyncLogger::MaxLineSize));
+    }
+    CHECK(logger.Dropped() == 0);
+  }
+
+  // a full ring drops lines instead of blocking
+  {
+    const auto sink = VQJS::CreateRef<Collector>();
+    sink->Hold = true;
+    AsyncLogger logger(sink, 1ms);
+    logger.Log(VQJS::Logger::Level::Info, "first");
+    {
+      std::unique_lock lock(sink->Mutex);
+      sink->Changed.wait(lock, [&sink] { return sink->Entered; });
+    }
+    // "first" still has its slot, so the last one doesn't fit
+    for (size_t i = 0; i < AsyncLogger::SlotCount; i++)
+      logger.Log(VQJS::Logger::Level::Info, "fill");
+    CHECK(logger.Dropped() == 1);
+    logger.Log(VQJS::Logger::Level::Info, Pattern(1000, 0));
+    CHECK(logger.Dropped() == 2);
+    sink->Release();
+    logger.Flush();
+    CHECK(sink->Lines.size() == AsyncLogger::SlotCount);
+    CHECK(sink->Lines.front() == "first" && sink->Lines.back() == "fill");
+    // there's room again
+    logger.Log(VQJS::Logger::Level::Info, Pattern(1000, 0));
+    logger.Flush();
+    CHECK(sink->Lines.back() == Pattern(1000, 0));
+    CHECK(logger.Dropped() == 2);
+  }
+
+  // several producers, each one's lines stay in order
+  {
+    constexpr int Threads = 4;
+    constexpr int Lines = 500;
+    const auto sink = VQJS::CreateRef<Collector>();
+    AsyncLogger logger(sink);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < Threads; t++) {
+      producers.emplace_back([&logger, t] {
+        for (int i = 0; i < Lines; i++) {
+          std::string line = std::to_string(t) + ":" + std::to_string(i);
+          if (i % 7 == 0)
+            line += ":" + Pattern(600, static_cast<char>(i));
+          logger.Log(VQJS::Logger::Level::Info, line);
+        }
+      });
+    }
+    for (auto &producer : producers)
+      producer.join();
+    logger.Flush();
+    CHECK(logger.Dropped() == 0);
+    CHECK(sink->Lines.size() == Threads * Lines);
+    std::vector<int> next(Threads, 0);
+    for (const auto &line : sink->Lines) {
+      const int t = std::stoi(line);
+      const size_t colon = line.find(':');
+      const int i = std::stoi(line.substr(colon + 1));
+      CHECK(i == next[t]++);
+      if (i % 7 == 0) {
+        const size_t tail = line.find(':', colon + 1);
+        CHECK(line.substr(tail + 1) == Pattern(600, static_cast<char>(i)));
+      }
+    }
+  }
+  return 0;
+}
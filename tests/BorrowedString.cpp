@@ -0,0 +1,59 @@
+#include "Check.h"
+#include "vqjs.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+int main() {
+  VQJS::Instance instance{"Test"};
+
+  // the borrow keeps the engine string alive, not the value it came from
+  VQJS::BorrowedString ascii =
+      instance.Eval("'plain ' + 'ascii'.repeat(3)").Borrow();
+  VQJS::BorrowedString utf8 = instance.Eval("'grüße ' + '𝄞'").Borrow();
+  (void)instance.Eval("for (let i = 0; i < 1000; i++) ({garbage: [i]});");
+  CHECK(ascii && ascii.View() == "plain asciiasciiascii");
+  CHECK(utf8.View() == "grüße 𝄞");
+  CHECK(ascii.Data()[ascii.Size()] == '\0');
+
+  // numbers and the rest never hit the engine strings
+  CHECK(instance.Eval("-2147483648 | 0").Borrow().View() == "-2147483648");
+  CHECK(instance.Eval("7").Borrow().View() == "7");
+  CHECK(instance.Eval("1.5").Borrow().View() == "1.5");
+  CHECK(instance.Eval("true").Borrow().View() == "true");
+  CHECK(instance.Eval("false").Borrow().View() == "false");
+  CHECK(instance.Eval("null").Borrow().View() == "null");
+  CHECK(instance.Eval("undefined").Borrow().View() == "undefined");
+  CHECK(instance.Eval("({toString() { return 'custom'; }})").Borrow().View() ==
+        "custom");
+  CHECK(instance.Eval("[1, [2, 3]]").AsString() == "1,2,3");
+
+  // moving keeps inline and engine owned data valid, the source is empty
+  VQJS::BorrowedString number = instance.Eval("12345").Borrow();
+  VQJS::BorrowedString moved = std::move(number);
+  CHECK(!number && number.Size() == 0);
+  CHECK(moved.View() == "12345");
+  std::vector<VQJS::BorrowedString> list;
+  list.push_back(std::move(moved));
+  list.push_back(std::move(ascii));
+  list.push_back(instance.Eval("'x'").Borrow());
+  CHECK(list[0].View() == "12345" && list[1].View() == "plain asciiasciiascii");
+  CHECK(list[2].View() == "x");
+
+  // a throwing toString gives an empty borrow, AsString falls back
+  const VQJS::Value bad =
+      instance.Eval("({toString() { throw new Error('no'); }})");
+  VQJS::BorrowedString failed = bad.Borrow();
+  CHECK(!failed && failed.Size() == 0);
+  // the error stays on the Context for the caller
+  CHECK(bad.Exception()["message"].AsString() == "no");
+  CHECK(bad.AsString() == "null");
+  (void)bad.Exception();
+  // the engine didn't get into a broken state on the way
+  CHECK(instance.Eval("'still ' + 'fine'").AsString() == "still fine");
+
+  VQJS::BorrowedString empty;
+  CHECK(!empty && empty.View().empty());
+  return 0;
+}
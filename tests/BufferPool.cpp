@@ -0,0 +1,59 @@
+#include "BufferPool.h"
+#include "Check.h"
+
+#include <cstdint>
+#include <cstring>
+
+using VQJS::BufferPool;
+
+static bool Aligned(const uint8_t *buffer, const size_t to) {
+  return reinterpret_cast<uintptr_t>(buffer) % to == 0;
+}
+
+int main() {
+  BufferPool &pool = BufferPool::Get();
+  pool.Trim();
+
+  // size classes are powers of two, released buffers get reused
+  uint8_t *first = pool.Allocate(100, false);
+  CHECK(first != nullptr);
+  CHECK(pool.Owns(first));
+  CHECK(pool.LiveBuffers() == 1);
+  CHECK(Aligned(first, BufferPool::Alignment));
+  CHECK(BufferPool::Capacity(first) == 128);
+  std::memset(first, 0xff, 100);
+  pool.Release(first);
+  CHECK(pool.CachedBytes() == 128);
+  CHECK(pool.LiveBuffers() == 0);
+  CHECK(pool.Owns(first));
+
+  uint8_t *second = pool.Allocate(120, true);
+  CHECK(second == first);
+  CHECK(pool.CachedBytes() == 0);
+  for (size_t i = 0; i < 120; i++)
+    CHECK(second[i] == 0);
+
+  // only the last reference returns it
+  pool.Retain(second);
+  pool.Release(second);
+  CHECK(pool.CachedBytes() == 0);
+  pool.Release(second);
+  CHECK(pool.CachedBytes() == 128);
+
+  uint8_t *large = pool.Allocate(BufferPool::LargeSize, true);
+  CHECK(Aligned(large, BufferPool::PageSize));
+  pool.Release(large);
+  CHECK(pool.CachedBytes() == 128 + BufferPool::LargeSize);
+
+  // above MaxPooledSize nothing is cached
+  uint8_t *huge = pool.Allocate(BufferPool::MaxPooledSize + 1, false);
+  CHECK(huge != nullptr);
+  pool.Release(huge);
+  CHECK(pool.CachedBytes() == 128 + BufferPool::LargeSize);
+
+  pool.Trim();
+  CHECK(pool.CachedBytes() == 0);
+  CHECK(!pool.Owns(first));
+  CHECK(!pool.Owns(huge));
+  return 0;
+}
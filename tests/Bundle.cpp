@@ -0,0 +1,70 @@
+#include "Bundle.h"
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+static std::string AsString(const std::span<const uint8_t> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+int main() {
+  const TestDir dir("bundle");
+
+  // file format on its own
+  {
+    VQJS::BundleWriter writer;
+    const std::string b = "second";
+    const std::string a = "first module";
+    writer.Add("b.js", reinterpret_cast<const uint8_t *>(b.data()), b.size());
+    writer.Add("a.js", reinterpret_cast<const uint8_t *>(a.data()), a.size());
+    writer.Add("empty.js", nullptr, 0);
+    CHECK(writer.Count() == 3);
+    CHECK(writer.Write(dir.Path + "raw.vqjsb", VQJS::Bundle::StripDebug));
+
+    VQJS::Bundle bundle;
+    CHECK(bundle.Open(dir.Path + "raw.vqjsb"));
+    CHECK(bundle.Count() == 3);
+    CHECK(bundle.Flags() == VQJS::Bundle::StripDebug);
+    CHECK(AsString(bundle.Find("a.js")) == a);
+    CHECK(AsString(bundle.Find("b.js")) == b);
+    CHECK(bundle.Find("empty.js").empty());
+    CHECK(bundle.Find("c.js").empty());
+
+    // a truncated index is rejected
+    std::filesystem::resize_file(dir.Path + "raw.vqjsb",
+                                 sizeof(VQJS::Bundle::Header) + 4);
+    VQJS::Bundle broken;
+    CHECK(!broken.Open(dir.Path + "raw.vqjsb"));
+    CHECK(!broken.Open(dir.Path + "missing.vqjsb"));
+  }
+
+  // module graph written by one runtime and loaded by another
+  dir.Write("lib.js", "export const value = 21;\n");
+  dir.Write("main.js", R"(
+import {value} from "@/lib.js";
+globalThis.result = value * 2;
+)");
+  {
+    VQJS::Runtime writer;
+    writer.GetConfig().UseTypescript = false;
+    writer.GetLoader().Add("@", dir.Path);
+    CHECK(writer.Start());
+    CHECK(writer.WriteBundle(dir.Path + "app.vqjsb", {"main.js"}));
+  }
+  // everything has to come from the bundle now
+  std::filesystem::remove(dir.Path + "lib.js");
+  std::filesystem::remove(dir.Path + "main.js");
+
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetLoader().Add("@", dir.Path);
+  CHECK(runtime.LoadBundle(dir.Path + "app.vqjsb"));
+  CHECK(runtime.Start());
+  CHECK(!runtime.LoadFile("main.js").IsException());
+  CHECK(runtime.GetInstance().Global()["result"].AsInt() == 42);
+  return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// Tests are plain executables, the first failed check ends them
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,84 @@
+#include "Check.h"
+#include "ClassBinding.h"
+#include "vqjs.h"
+
+struct Counter {
+  int Count{0};
+};
+
+int main() {
+  VQJS::Instance instance{"Test"};
+  VQJS::ClassBinding<Counter> binding("Counter");
+  binding
+      .AddMethod("increment",
+                 [](Counter &self, const VQJS::Value &_,
+                    const std::vector<VQJS::Value> &) {
+                   return _.Number(++self.Count);
+                 })
+      .AddProperty(
+          "count",
+          [](Counter &self, const VQJS::Value &_) {
+            return _.Number(self.Count);
+          },
+          [](Counter &self, const VQJS::Value &_, const VQJS::Value &value) {
+            if (value.AsInt() < 0) {
+              (void)_.ThrowException("negative");
+              return;
+            }
+            self.Count = static_cast<int>(value.AsInt());
+          });
+
+  const auto counter = VQJS::CreateRef<Counter>();
+  instance.Global().Set("counter", binding.New(instance, counter));
+  CHECK(binding.Get(instance.Global()["counter"]) == counter.get());
+
+  const VQJS::Value caught = instance.Eval(R"(
+let caught = false;
+try { counter.count = -1; } catch (e) { caught = e === "negative"; }
+counter.count = 4;
+counter.increment();
+caught;
+)");
+  CHECK(caught.AsBool());
+  CHECK(counter->Count == 5);
+
+  // not caught, so the script stops at the setter
+  const VQJS::Value thrown =
+      instance.Eval("counter.count = -2; counter.count = 10;");
+  CHECK(thrown.IsException());
+  CHECK(counter->Count == 5);
+
+  // derived classes keep their own prototype
+  binding.SetConstructor([](const VQJS::Value &, const auto &args) {
+    auto created = VQJS::CreateRef<Counter>();
+    created->Count = args.empty() ? 0 : static_cast<int>(args[0].AsInt());
+    return created;
+  });
+  instance.Global().Set("Counter", binding.Constructor(instance));
+  CHECK(instance
+            .Eval(R"(
+class Twice extends Counter {
+  twice() { this.increment(); return this.increment(); }
+}
+const twice = new Twice(3);
+twice instanceof Twice && twice instanceof Counter &&
+  twice.twice() === 5 && new Counter(1).increment() === 2 &&
+  !(new Counter() instanceof Twice)
+)")
+            .AsBool());
+  CHECK(binding.Get(instance.Global()["twice"]) != nullptr);
+
+  // siblings on the same runtime share the class, objects can move between
+  // them
+  VQJS::Instance sibling{"Sibling", instance};
+  const auto other = VQJS::CreateRef<Counter>();
+  sibling.Global().Set("counter", binding.New(sibling, other));
+  sibling.Global().Set("foreign", instance.Global()["counter"]);
+  CHECK(sibling.Eval("counter.increment() + foreign.increment()").AsInt() ==
+        7);
+  CHECK(binding.Get(sibling.Global()["foreign"]) == counter.get());
+  instance.Global().Set("foreign", sibling.Global()["counter"]);
+  CHECK(instance.Eval("foreign.count").AsInt() == 1);
+  CHECK(binding.Get(instance.Global()["foreign"]) == other.get());
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "Check.h"
+#include "CommandBuffer.h"
+#include "vqjs.h"
+
+#include <string>
+#include <vector>
+
+// Reset is only for the Runtime, tests get to call it directly
+struct ResettableInstance : VQJS::Instance {
+  using Instance::Instance;
+  using Instance::Reset;
+};
+
+int main() {
+  ResettableInstance instance{"Test"};
+  VQJS::CommandBuffer commands{4};
+  std::vector<std::string> log;
+  CHECK(commands.Register("move", 2, [&](const auto &args) {
+    log.push_back("move " + std::to_string(args.template As<int>(0)) + " " +
+                  std::to_string(args.template As<int>(1)));
+  }) == 0);
+  CHECK(commands.Register("clear", 0,
+                          [&](const auto &) { log.push_back("clear"); }) ==
+        1);
+
+  // names end up in the encoder source
+  using Buffer = VQJS::CommandBuffer;
+  CHECK(commands.Register("x(){}}; evil(", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("two words", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("q'uote", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("1st", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("reserve", 0, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("move", 1, {}) == Buffer::InvalidOpcode);
+  CHECK(commands.Register("$set_2", 1, [&](const auto &args) {
+    log.push_back("set " + std::to_string(args[0]).substr(0, 3));
+  }) == 2);
+
+  instance.Global().Set("cmd", commands.CreateEncoder(instance));
+  CHECK(commands.Drain(instance) == 0);
+
+  // more than the initial capacity, the encoder has to grow on the way
+  CHECK(!instance
+             .Eval("cmd.move(1, 2); cmd.clear(); cmd.$set_2(1.5);"
+                   "for (let i = 0; i < 3; i++) cmd.move(i, -i);")
+             .IsException());
+  CHECK(commands.Drain(instance) == 6);
+  const std::vector<std::string> expected = {
+      "move 1 2", "clear", "set 1.5", "move 0 0", "move 1 -1", "move 2 -2"};
+  CHECK(log == expected);
+  CHECK(instance.Eval("cmd.length").AsInt() == 0);
+  CHECK(commands.Drain(instance) == 0);
+
+  // the old encoder is dropped instead of read after a Reset
+  CHECK(!instance.Eval("cmd.clear()").IsException());
+  instance.Reset();
+  log.clear();
+  CHECK(commands.Drain(instance) == 0);
+  CHECK(log.empty());
+  instance.Global().Set("cmd", commands.CreateEncoder(instance));
+  CHECK(!instance.Eval("cmd.clear()").IsException());
+  CHECK(commands.Drain(instance) == 1);
+  CHECK(log.size() == 1 && log[0] == "clear");
+  return 0;
+}
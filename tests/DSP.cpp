@@ -0,0 +1,88 @@
+#include "Check.h"
+#include "DSP.h"
+
+#include <cmath>
+#include <vector>
+
+namespace DSP = VQJS::DSP;
+
+static bool Near(const double a, const double b, const double eps = 1e-9) {
+  return std::fabs(a - b) <= eps * std::max(1.0, std::fabs(b));
+}
+
+int main() {
+  // odd sizes and offsets, so every kernel runs its vector body, the scalar
+  // tail and unaligned loads
+  for (const size_t size : {1, 3, 7, 16, 33, 101}) {
+    std::vector<double> a(size + 1);
+    std::vector<double> b(size + 1);
+    for (size_t i = 0; i < a.size(); i++) {
+      a[i] = std::sin(static_cast<double>(i) * 0.37) * 3.0;
+      b[i] = std::cos(static_cast<double>(i) * 0.11) - 0.5;
+    }
+    const double *x = a.data() + 1;
+    const double *y = b.data() + 1;
+
+    double sum = 0;
+    double squares = 0;
+    double peak = 0;
+    for (size_t i = 0; i < size; i++) {
+      sum += x[i];
+      squares += x[i] * x[i];
+      peak = std::max(peak, std::fabs(x[i]));
+    }
+    CHECK(Near(DSP::Sum(x, size), sum));
+    CHECK(Near(DSP::Rms(x, size), std::sqrt(squares / size)));
+    CHECK(DSP::Peak(x, size) == peak);
+
+    std::vector<double> out(size);
+    DSP::Add(out.data(), x, y, size);
+    for (size_t i = 0; i < size; i++)
+      CHECK(out[i] == x[i] + y[i]);
+    DSP::Mul(out.data(), x, 0.25, size);
+    for (size_t i = 0; i < size; i++)
+      CHECK(out[i] == x[i] * 0.25);
+    DSP::Mix(out.data(), x, y, 0.3, size);
+    for (size_t i = 0; i < size; i++)
+      CHECK(Near(out[i], x[i] + (y[i] - x[i]) * 0.3));
+  }
+
+  // a cosine on bin 5 and a sine on bin 12, everything else stays empty
+  constexpr size_t Size = 64;
+  constexpr double Pi = 3.14159265358979323846;
+  std::vector<double> signal(Size);
+  for (size_t i = 0; i < Size; i++) {
+    const double t = static_cast<double>(i) / Size;
+    signal[i] = std::cos(2 * Pi * 5 * t) + 0.5 * std::sin(2 * Pi * 12 * t);
+  }
+  std::vector<double> re(Size / 2 + 1);
+  std::vector<double> im(Size / 2 + 1);
+  CHECK(DSP::RealFFT(signal.data(), Size, re.data(), im.data()));
+  for (size_t k = 0; k <= Size / 2; k++) {
+    const double expectRe = k == 5 ? Size / 2.0 : 0.0;
+    const double expectIm = k == 12 ? -(Size / 4.0) : 0.0;
+    CHECK(std::fabs(re[k] - expectRe) < 1e-9);
+    CHECK(std::fabs(im[k] - expectIm) < 1e-9);
+  }
+  std::vector<double> magnitudes(Size / 2 + 1);
+  CHECK(DSP::Spectrum(signal.data(), Size, magnitudes.data()));
+  CHECK(Near(magnitudes[5], Size / 2.0) && Near(magnitudes[12], Size / 4.0));
+  CHECK(!DSP::RealFFT(signal.data(), 48, re.data(), im.data()));
+
+  // more sizes than the plan cache keeps, the evicted ones come back right
+  for (size_t size = 2; size <= (size_t{1} << 20); size <<= 1) {
+    std::vector<double> in(size, 1.0);
+    std::vector<double> bins(size / 2 + 1);
+    CHECK(DSP::Spectrum(in.data(), size, bins.data()));
+    CHECK(Near(bins[0], static_cast<double>(size)));
+  }
+  CHECK(DSP::RealFFT(signal.data(), Size, re.data(), im.data()));
+  CHECK(std::fabs(re[5] - Size / 2.0) < 1e-9);
+
+  // Hann is zero at both ends and one in the middle
+  std::vector<double> window(9, 2.0);
+  DSP::ApplyWindow(window.data(), window.size(), DSP::Window::Hann);
+  CHECK(Near(window[0] + 1.0, 1.0) && Near(window[4], 2.0));
+  CHECK(Near(window[8] + 1.0, 1.0));
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include "Check.h"
+#include "vqjs.h"
+
+#include <cstdint>
+#include <quickjs/quickjs.h>
+
+using namespace std::chrono_literals;
+
+int main() {
+  VQJS::Instance app{"App"};
+  int collected = 0;
+  VQJS::GCPolicy policy{};
+  policy.OnCollect = [&collected](VQJS::Instance &, const VQJS::GCEvent &) {
+    collected++;
+  };
+  app.SetGCPolicy(policy);
+  CHECK(!app.Eval(R"(
+let garbage = [];
+for (let i = 0; i < 50000; i++)
+  garbage.push({i, list: [i, i + 1]});
+garbage = null;
+)")
+             .IsException());
+
+  // nothing measured yet, the first estimate still has to fit the budget
+  CHECK(!app.Idle(0us));
+  CHECK(collected == 0);
+  CHECK(app.Idle(10s));
+  CHECK(collected == 1);
+  // nothing new to collect
+  CHECK(!app.Idle(10s));
+
+  // frames of two instances on one runtime interleave, the automatic GC
+  // has to come back after both ended
+  JSRuntime *rt = app.GetContext();
+  VQJS::Instance shared{"Shared", app};
+  app.BeginFrame();
+  shared.BeginFrame();
+  CHECK(JS_GetGCThreshold(rt) == SIZE_MAX);
+  app.EndFrame();
+  shared.EndFrame();
+  CHECK(JS_GetGCThreshold(rt) != SIZE_MAX);
+  return 0;
+}
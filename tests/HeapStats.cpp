@@ -0,0 +1,45 @@
+#include "Check.h"
+#include "vqjs.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+int main() {
+  VQJS::Instance first{"First"};
+  VQJS::Instance second{"Second"};
+  const auto before = first.GetHeapStats();
+  const auto untouched = second.GetHeapStats();
+  CHECK(before.LiveBytes > 0 && before.LiveAllocations > 0);
+  CHECK(before.PeakBytes >= before.LiveBytes);
+
+  // every runtime counts its own allocations
+  CHECK(!first.Eval("globalThis.big = new Array(1 << 20).fill(0.5)")
+             .IsException());
+  const auto grown = first.GetHeapStats();
+  CHECK(grown.LiveBytes >= before.LiveBytes + 8 * (1 << 20));
+  CHECK(grown.TotalAllocations > before.TotalAllocations);
+  CHECK(grown.PeakBytes >= grown.LiveBytes);
+  CHECK(second.GetHeapStats().TotalAllocations ==
+        untouched.TotalAllocations);
+  CHECK(second.GetHeapStats().LiveBytes == untouched.LiveBytes);
+  CHECK(first.GetMemoryStats().Heap.LiveBytes == grown.LiveBytes);
+
+  // freed memory leaves the live count, the peak stays
+  CHECK(!first.Eval("globalThis.big = null").IsException());
+  (void)first.Idle(10s);
+  const auto freed = first.GetHeapStats();
+  CHECK(freed.LiveBytes < grown.LiveBytes - 4 * (1 << 20));
+  CHECK(freed.PeakBytes >= grown.LiveBytes);
+
+  // released on another thread, the owner destroys the heap later on
+  auto moved = VQJS::CreateRef<VQJS::Instance>("Moved");
+  CHECK(moved->Eval("[1, 2, 3].length").AsInt() == 3);
+  std::thread([instance = std::move(moved)]() mutable {
+    instance.reset();
+  }).join();
+  VQJS::Instance after{"After"};
+  CHECK(after.Eval("'still' + ' fine'").AsString() == "still fine");
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "Check.h"
+#include "Json.h"
+#include "vqjs.h"
+
+#include <string>
+
+// stringify has to match JSON.stringify, parse has to give back the same
+static void RoundTrip(VQJS::Instance &instance, const std::string &value) {
+  const std::string source = "(() => { const value = " + value + R"(;
+const ours = json.stringify(value);
+if (ours !== JSON.stringify(value))
+  return "stringify: " + ours + " != " + JSON.stringify(value);
+if (JSON.stringify(json.parse(ours)) !== ours)
+  return "parse: " + ours;
+return "";
+})())";
+  const std::string result = instance.Eval(source).AsString();
+  if (!result.empty()) {
+    std::fprintf(stderr, "%s: %s\n", value.c_str(), result.c_str());
+    CHECK(result.empty());
+  }
+}
+
+int main() {
+  VQJS::Instance instance{"Test"};
+  VQJS::Json::Install(instance.Global());
+
+  RoundTrip(instance, R"({"a": 1, "b": [true, false, null], "c": "text"})");
+  RoundTrip(instance, "[0, -0, 1.5, -2e-7, 1e21, 123456789012345678, NaN]");
+  RoundTrip(instance, R"(["quote \" slash \\ tab \t", "\u0001", "ö€𝄞"])");
+  RoundTrip(instance, "{a: undefined, b: () => 1, c: [undefined]}");
+  RoundTrip(instance, "[new Number(3), new String('s'), new Boolean(0)]");
+  RoundTrip(instance, "{n: Object(1.5), s: Object('x'), b: Object(true)}");
+  RoundTrip(instance, "['\\ud800', 'a\\udc00b', '\\ud834\\udd1e']");
+  RoundTrip(instance, "{deep: {deeper: {deepest: [[[]]]}}}");
+
+  // toJSON gets the key or the index as a string
+  RoundTrip(instance, "{key: {toJSON(k) { return k; }}}");
+  RoundTrip(instance, "[1, {toJSON(k) { return typeof k + k; }}]");
+  RoundTrip(instance, "{toJSON(k) { return [k]; }}");
+  RoundTrip(instance, "{date: new Date(0)}");
+
+  CHECK(instance.Eval("json.stringify({a: 1n})").IsException());
+  CHECK(instance.Eval("const c = {}; c.c = c; json.stringify(c)")
+            .IsException());
+  CHECK(instance.Eval("json.parse('{\"a\": }')").IsException());
+
+  // buffers are parsed as UTF-8, shared ones included
+  CHECK(instance
+            .Eval(R"(
+const text = '{"shared": [1, 2]}';
+const bytes = Uint8Array.from(text, (c) => c.charCodeAt(0));
+const shared = new SharedArrayBuffer(bytes.length);
+new Uint8Array(shared).set(bytes);
+json.parse(shared).shared[1] + json.parse(bytes).shared[0] +
+  json.parse(bytes.buffer).shared.length;
+)")
+            .AsInt() == 5);
+
+  std::string out;
+  CHECK(VQJS::Json::Stringify(instance.Eval("({x: [1, 'y']})"), out));
+  CHECK(out == R"({"x":[1,"y"]})");
+
+  // the reused buffer gets big once, small documents still come out right
+  CHECK(instance.Eval("json.stringify('x'.repeat(3 << 20)).length")
+            .AsInt() == (3 << 20) + 2);
+  CHECK(instance.Eval("json.stringify([1])").AsString() == "[1]");
+
+  // boxed values are told apart by their class, not by the constructors a
+  // script can replace
+  out.clear();
+  CHECK(VQJS::Json::Stringify(
+      instance.Eval("[Object(2), Object('s'), Object(false)]"), out));
+  CHECK(out == R"([2,"s",false])");
+  CHECK(instance
+            .Eval(R"(
+const boxed = [Object(1), Object("t"), Object(true)];
+globalThis.Number = globalThis.String = globalThis.Boolean = function () {};
+json.stringify(boxed)
+)")
+            .AsString() == R"([1,"t",true])");
+  return 0;
+}
@@ -0,0 +1,36 @@
+#include "Check.h"
+#include "vqjs.h"
+
+static constexpr size_t MiB = 1024 * 1024;
+
+int main() {
+  VQJS::Instance app{"App"};
+  app.SetMemoryLimit(16 * MiB);
+
+  // the limit belongs to the runtime, a shared instance can't drop it
+  VQJS::Instance shared{"Shared", app};
+  shared.SetMemoryLimit(0);
+  CHECK(app.Eval("new ArrayBuffer(64 * 1024 * 1024)").IsException());
+  CHECK(shared.Eval("new ArrayBuffer(64 * 1024 * 1024)").IsException());
+  CHECK(!app.Eval("new ArrayBuffer(1024)").IsException());
+
+  // onExceeded is checked from the interrupt handler, returning true stops
+  // the script before it reaches the limit
+  int exceeded = 0;
+  app.SetMemoryLimit(
+      16 * MiB,
+      [&exceeded](VQJS::Instance &, const VQJS::MemoryStats &) {
+        exceeded++;
+        return true;
+      },
+      0.25f);
+  shared.SetMemoryLimit(0);
+  const VQJS::Value stopped = app.Eval(R"(
+const keep = [];
+for (let i = 0; i < 100000; i++)
+  keep.push({i, text: "item " + i});
+)");
+  CHECK(stopped.IsException());
+  CHECK(exceeded == 1);
+  return 0;
+}
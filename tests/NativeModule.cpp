@@ -0,0 +1,35 @@
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+int main() {
+  const TestDir dir("native-module");
+  dir.Write("main.js", R"(
+import {answer} from "native:answer";
+import {missing} from "native:empty";
+globalThis.answer = answer;
+globalThis.missing = missing;
+)");
+
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetLoader().Add("@", dir.Path);
+  int created = 0;
+  runtime.GetLoader().AddNative(
+      "native:answer", {"answer"}, [&created](const VQJS::Value &exports) {
+        created++;
+        exports.Set("answer", exports.Number(42));
+      });
+  // exports without Initialize end up undefined instead of throwing
+  runtime.GetLoader().AddNative("native:empty", {{"missing"}, {}});
+  CHECK(runtime.Start());
+  CHECK(created == 0);
+
+  const VQJS::Value main = runtime.LoadFile("main.js");
+  CHECK(!main.IsException());
+  const VQJS::Value global = runtime.GetInstance().Global();
+  CHECK(created == 1);
+  CHECK(global["answer"].AsInt() == 42);
+  CHECK(!global["missing"].IsNumber());
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include "Check.h"
+#include "ClassBinding.h"
+#include "ObjectProvider.h"
+#include "vqjs.h"
+
+struct Config : VQJS::ObjectProvider {
+  int Width{640};
+
+  bool Get(const VQJS::Value &self, const std::string &key,
+           VQJS::Value &out) override {
+    if (key != "width")
+      return false;
+    out = self.Number(Width);
+    return true;
+  }
+
+  std::vector<std::string> Keys() override { return {"width"}; }
+
+  bool Set(const VQJS::Value &, const std::string &key,
+           const VQJS::Value &value) override {
+    if (key != "width")
+      return false;
+    Width = static_cast<int>(value.AsInt());
+    return true;
+  }
+};
+
+struct Empty {};
+
+int main() {
+  const auto config = VQJS::CreateRef<Config>();
+
+  VQJS::Instance first{"First"};
+  first.Global().Set("config", VQJS::ObjectProvider::New(first, config));
+  CHECK(first.Eval("config.width").AsInt() == 640);
+
+  // the second runtime hands out its class ids in another order, the
+  // provider must not end up with the id of the binding
+  VQJS::Instance second{"Second"};
+  VQJS::ClassBinding<Empty> binding("Empty");
+  second.Global().Set("empty",
+                      binding.New(second, VQJS::CreateRef<Empty>()));
+  second.Global().Set("config", VQJS::ObjectProvider::New(second, config));
+  CHECK(second.Eval("config.width = 800; config.width").AsInt() == 800);
+  CHECK(second.Eval("Object.keys(config).join()").AsString() == "width");
+  CHECK(second.Eval("config.extra = 1; config.extra").AsInt() == 1);
+  CHECK(binding.Get(second.Global()["empty"]) != nullptr);
+  CHECK(first.Eval("config.width").AsInt() == 800);
+
+  // siblings on the runtime of first use its class
+  VQJS::Instance sibling{"Sibling", first};
+  sibling.Global().Set("config", VQJS::ObjectProvider::New(sibling, config));
+  sibling.Global().Set("foreign", first.Global()["config"]);
+  CHECK(sibling.Eval("config.width = 320; foreign.width").AsInt() == 320);
+  CHECK(sibling.Eval("Object.keys(foreign).join()").AsString() == "width");
+  return 0;
+}
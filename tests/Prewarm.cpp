@@ -0,0 +1,65 @@
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+#include <string>
+
+static bool KeepsSource(VQJS::Runtime &runtime) {
+  return runtime.GetInstance()
+             .Eval("(function f() { return 41 + 1; }).toString()")
+             .AsString()
+             .find("41 + 1") != std::string::npos;
+}
+
+int main() {
+  const TestDir dir("prewarm");
+  dir.Write("main.js", "globalThis.loaded = (globalThis.loaded ?? 0) + 1;");
+
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetConfig().PrewarmReset = true;
+  runtime.GetLoader().Add("@", dir.Path);
+  // the first one is built directly, the standby for the next one starts
+  CHECK(runtime.Start());
+
+  VQJS::Instance &app = runtime.GetInstance();
+  app.SetMemoryLimit(64 * 1024 * 1024);
+  CHECK(!runtime.LoadFile("main.js").IsException());
+  CHECK(app.Eval("loaded").AsInt() == 1);
+
+  // swapped in: fresh globals, prepared like the first one, same settings
+  CHECK(runtime.Reset());
+  CHECK(&runtime.GetInstance() == &app);
+  CHECK(app.GetName() == "App");
+  CHECK(app.Eval("typeof loaded").AsString() == "undefined");
+  CHECK(app.Eval("typeof console.log === 'function' && "
+                 "typeof Worker === 'function' && typeof vqjs.json === "
+                 "'object'")
+            .AsBool());
+  CHECK(app.GetMemoryStats().Limit == 64 * 1024 * 1024);
+  CHECK(!runtime.LoadFile("main.js").IsException());
+  CHECK(app.Eval("loaded").AsInt() == 1);
+  CHECK(KeepsSource(runtime));
+
+  // the standby got built before Strip was set, it must not be used
+  runtime.GetConfig().Strip = true;
+  CHECK(runtime.Reset());
+  CHECK(!KeepsSource(runtime));
+  CHECK(app.Eval("typeof loaded").AsString() == "undefined");
+  // this standby has it already
+  CHECK(runtime.Reset());
+  CHECK(!KeepsSource(runtime));
+
+  runtime.GetConfig().Strip = false;
+  CHECK(runtime.Reset());
+  CHECK(KeepsSource(runtime));
+
+  // without prewarming Reset builds it directly again
+  runtime.GetConfig().PrewarmReset = false;
+  CHECK(runtime.Reset());
+  CHECK(runtime.Reset());
+  CHECK(KeepsSource(runtime));
+  CHECK(!runtime.LoadFile("main.js").IsException());
+  CHECK(app.Eval("loaded").AsInt() == 1);
+  return 0;
+}
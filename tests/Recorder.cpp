@@ -0,0 +1,102 @@
+#include "Check.h"
+#include "Recorder.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using VQJS::Recorder;
+using Args = std::vector<VQJS::Value>;
+
+int main() {
+  const TestDir dir("recorder");
+  const std::string log = dir.Path + "session.vqjsr";
+  {
+    VQJS::Instance instance{"Record"};
+    auto recorder = VQJS::CreateRef<Recorder>(log);
+    CHECK(recorder->IsOpen());
+    instance.SetRecorder(recorder);
+
+    VQJS::Value global = instance.Global();
+    global.AddFunction("answer",
+                       [](const VQJS::Value &_, const Args &) {
+                         return _.Number(42);
+                       });
+    global.AddFunction("fail",
+                       [](const VQJS::Value &_, const Args &) {
+                         return _.ThrowException("boom");
+                       });
+    CHECK(!instance
+               .Eval(R"(
+globalThis.shared = new SharedArrayBuffer(8);
+new Uint8Array(shared)[0] = 7;
+globalThis.view = new Int16Array(shared, 2, 2);
+view[1] = -3;
+function handle(...args) {
+  answer();
+  try { fail(); } catch (e) {}
+  return args.length;
+}
+)")
+               .IsException());
+    const VQJS::Value handle = global["handle"];
+    const VQJS::Value result = handle.Call(
+        {global.Number(1), handle, global["shared"], global["view"]});
+    CHECK(result.AsInt() == 4);
+    instance.SetRecorder(nullptr);
+  }
+
+  std::vector<Recorder::Event> events;
+  CHECK(Recorder::Read(log, events));
+  std::vector<Recorder::Kind> kinds;
+  for (const auto &event : events)
+    kinds.push_back(event.Type);
+  CHECK((kinds == std::vector{Recorder::Kind::Native, Recorder::Kind::Native,
+                              Recorder::Kind::Call, Recorder::Kind::Result,
+                              Recorder::Kind::Throw}));
+
+  VQJS::Instance replay{"Replay"};
+  VQJS::Value global = replay.Global();
+
+  // every argument on its own, the function doesn't take the others along
+  const auto args = Recorder::DecodeArgs(global, events[2].Data);
+  CHECK(events[2].Name == "handle");
+  CHECK(args.size() == 4);
+  CHECK(args[0].AsInt() == 1);
+  CHECK(!args[1].IsFunction());
+  global.Set("shared", args[2]);
+  global.Set("view", args[3]);
+  CHECK(replay
+            .Eval(R"(
+shared instanceof ArrayBuffer && new Uint8Array(shared)[0] === 7 &&
+  view instanceof Int16Array && view.length === 2 && view[1] === -3 &&
+  view.buffer !== shared
+)")
+            .AsBool());
+
+  CHECK(events[3].Name == "answer");
+  CHECK(Recorder::Replay(global, events[3]).AsInt() == 42);
+  CHECK(events[4].Name == "fail");
+  const VQJS::Value thrown = Recorder::Replay(global, events[4]);
+  CHECK(thrown.IsException());
+  CHECK(thrown.Exception().AsString() == "boom");
+
+  // an unknown kind means the log is broken, not an event to skip
+  {
+    std::ifstream input(log, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator(input)),
+                      std::istreambuf_iterator<char>());
+    // after magic and version
+    bytes[8] = static_cast<char>(Recorder::Kind::Throw) + 1;
+    dir.Write("broken.vqjsr", bytes);
+    std::vector<Recorder::Event> broken;
+    CHECK(!Recorder::Read(dir.Path + "broken.vqjsr", broken));
+    bytes[8] = static_cast<char>(Recorder::Kind::Throw);
+    dir.Write("fixed.vqjsr", bytes);
+    CHECK(Recorder::Read(dir.Path + "fixed.vqjsr", broken));
+  }
+  return 0;
+}
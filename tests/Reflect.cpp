@@ -0,0 +1,76 @@
+#include "Check.h"
+#include "Reflect.h"
+#include "vqjs.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+struct Vec3 {
+  double x, y, z;
+};
+VQJS_REFLECT(Vec3, x, y, z)
+
+enum class Kind : uint8_t { Spawn = 1, Despawn = 2 };
+
+struct Event {
+  int64_t id{0};
+  std::string name{};
+  bool active{false};
+  Kind kind{Kind::Spawn};
+  std::optional<Vec3> pos{};
+  std::vector<Vec3> path{};
+  std::vector<std::string> tags{};
+  float weight{0};
+};
+VQJS_REFLECT(Event, id, name, active, kind, pos, path, tags, weight)
+
+int main() {
+  VQJS::Instance instance{"Test"};
+  VQJS::Value global = instance.Global();
+
+  Event event{};
+  event.id = (int64_t{1} << 40) + 3;
+  event.name = "spawn ö";
+  event.active = true;
+  event.kind = Kind::Despawn;
+  event.pos = Vec3{1, 2, 3};
+  event.path = {{0, 0, 0}, {0.5, -1, 2}};
+  event.tags = {"a", "b"};
+  event.weight = 0.25f;
+  global.Set("event", VQJS::ToJS(instance, event));
+  CHECK(instance
+            .Eval(R"(
+Object.keys(event).join() === "id,name,active,kind,pos,path,tags,weight" &&
+  event.id === 2 ** 40 + 3 && event.name === "spawn ö" &&
+  event.active === true && event.kind === 2 && event.pos.z === 3 &&
+  event.path[1].y === -1 && event.tags.join() === "a,b" &&
+  event.weight === 0.25
+)")
+            .AsBool());
+
+  // objects built in field order, whatever order the script used
+  global.Set("other", VQJS::ToJS(instance, Vec3{4, 5, 6}));
+  CHECK(instance.Eval("Object.keys(other).join()").AsString() == "x,y,z");
+
+  // and back, missing fields keep their value, null resets optionals
+  Event read = VQJS::FromJS<Event>(global["event"]);
+  CHECK(read.id == event.id && read.name == event.name && read.active);
+  CHECK(read.kind == Kind::Despawn && read.pos && read.pos->y == 2);
+  CHECK(read.path.size() == 2 && read.path[1].z == 2);
+  CHECK(read.tags == event.tags && read.weight == 0.25f);
+
+  CHECK(VQJS::FromJS(instance.Eval("({name: 'renamed', pos: null})"), read));
+  CHECK(read.name == "renamed" && !read.pos && read.id == event.id);
+
+  // wrong types are reported, not guessed
+  CHECK(!VQJS::FromJS(instance.Eval("({id: 'one'})"), read));
+  CHECK(!VQJS::FromJS(instance.Eval("({path: [{x: true}]})"), read));
+  CHECK(!VQJS::FromJS(instance.Eval("({tags: 'a,b'})"), read));
+  CHECK(!VQJS::FromJS(instance.Eval("42"), read));
+
+  std::vector<Vec3> list;
+  CHECK(VQJS::FromJS(instance.Eval("[{x: 1}, {y: 2, z: 3}]"), list));
+  CHECK(list.size() == 2 && list[0].x == 1 && list[1].z == 3);
+  return 0;
+}
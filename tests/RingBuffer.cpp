@@ -0,0 +1,77 @@
+#include "Check.h"
+#include "RingBuffer.h"
+#include "vqjs.h"
+
+#include <vector>
+
+using VQJS::RingBuffer;
+
+int main() {
+  // rounded up to a power of two
+  RingBuffer<float> ring(6, 2);
+  CHECK(ring.Capacity() == 8);
+  CHECK(ring.Channels() == 2);
+
+  std::vector<float> left(8);
+  std::vector<float> right(8);
+  float value = 0;
+  // moves the indices around the end a few times
+  for (int round = 0; round < 5; round++) {
+    for (size_t i = 0; i < 5; i++) {
+      left[i] = value;
+      right[i] = -value;
+      value++;
+    }
+    const float *in[] = {left.data(), right.data()};
+    CHECK(ring.Write(in, 5) == 5);
+    CHECK(ring.Available() == 5);
+    CHECK(ring.Space() == 3);
+
+    std::vector<float> outLeft(5);
+    std::vector<float> outRight(5);
+    float *out[] = {outLeft.data(), outRight.data()};
+    CHECK(ring.Read(out, 2, 5) == 5);
+    for (size_t i = 0; i < 5; i++) {
+      CHECK(outLeft[i] == left[i]);
+      CHECK(outRight[i] == right[i]);
+    }
+    CHECK(ring.Available() == 0);
+  }
+
+  // full, the rest is dropped and counted
+  const float *in[] = {left.data(), right.data()};
+  CHECK(ring.Write(in, 5) == 5);
+  CHECK(ring.Write(in, 5) == 3);
+  CHECK(ring.Overruns() == 2);
+
+  // skipped channels are consumed as well
+  std::vector<float> outLeft(8);
+  float *out[] = {outLeft.data(), nullptr};
+  CHECK(ring.Read(out, 2, 8) == 8);
+  CHECK(outLeft[5] == left[0]);
+  CHECK(outLeft[7] == left[2]);
+  CHECK(ring.Available() == 0);
+
+  // scripts only get the samples, the indices stay out of reach
+  {
+    VQJS::Instance instance{"Test"};
+    auto shared = VQJS::CreateRef<RingBuffer<float>>(4, 2);
+    instance.Global().Set("ring",
+                          RingBuffer<float>::Bind(shared, instance.Global()));
+    const float samples[] = {1, 2, 3};
+    const float *channels[] = {samples, samples};
+    CHECK(shared->Write(channels, 3) == 3);
+    CHECK(instance.Eval("ring.buffer.byteLength").AsInt() == 4 * 2 * 4);
+    CHECK(!instance.Eval("new Uint32Array(ring.buffer).fill(0xffffffff)")
+               .IsException());
+    CHECK(shared->Available() == 3);
+    CHECK(shared->Overruns() == 0);
+
+    // same element size, wrong type
+    CHECK(instance.Eval("ring.read(new Int32Array(4))").IsException());
+    CHECK(instance.Eval("ring.read(new Float64Array(4))").IsException());
+    CHECK(instance.Eval("ring.read(new Float32Array(4))").AsInt() == 3);
+    CHECK(shared->Available() == 0);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include "Check.h"
+#include "Scheduler.h"
+#include "vqjs.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+int main() {
+  const auto app = VQJS::CreateRef<VQJS::Instance>("App");
+  std::vector<VQJS::Ref<VQJS::Instance>> instances{app};
+  // same runtime as app, they have to share its strand
+  for (int i = 0; i < 3; i++)
+    instances.push_back(VQJS::CreateRef<VQJS::Instance>("Shared", *app));
+  for (int i = 0; i < 2; i++)
+    instances.push_back(VQJS::CreateRef<VQJS::Instance>("Isolated"));
+  for (const auto &instance : instances)
+    CHECK(!instance->Eval("globalThis.order = [];").IsException());
+
+  // runtimes that are busy right now, app and its shared ones count as one
+  std::mutex mutex;
+  std::map<const void *, int> active;
+  std::atomic<int> overlaps{0};
+  const auto runtimeOf = [&app](VQJS::Instance &instance) {
+    return &instance == app.get() || instance.GetName() == "Shared"
+               ? static_cast<const void *>(app.get())
+               : static_cast<const void *>(&instance);
+  };
+
+  VQJS::Scheduler scheduler(4);
+  for (int round = 0; round < 50; round++) {
+    for (const auto &instance : instances) {
+      scheduler.Post(instance, [&, round](VQJS::Instance &self) {
+        const void *runtime = runtimeOf(self);
+        {
+          std::lock_guard lock(mutex);
+          if (active[runtime]++ > 0)
+            overlaps++;
+        }
+        std::this_thread::sleep_for(20us);
+        (void)self.Eval("order.push(" + std::to_string(round) + ");");
+        std::lock_guard lock(mutex);
+        active[runtime]--;
+      });
+    }
+  }
+  scheduler.Wait();
+  CHECK(overlaps == 0);
+  // every instance saw its tasks in the order they were posted
+  for (const auto &instance : instances) {
+    CHECK(instance
+              ->Eval("order.length === 50 && "
+                     "order.every((round, i) => round === i)")
+              .AsBool());
+  }
+
+  const auto count = [](VQJS::Instance &self) {
+    (void)self.Eval("globalThis.frames = (globalThis.frames ?? 0) + 1;");
+  };
+  const auto done = scheduler.Frame(
+      instances, count, VQJS::Scheduler::Clock::now() + 10s);
+  CHECK(done.Completed == instances.size());
+  CHECK(done.Skipped == 0);
+  CHECK(!done.Late);
+  const auto late = scheduler.Frame(
+      instances, count, VQJS::Scheduler::Clock::now() - 1ms);
+  CHECK(late.Skipped == instances.size());
+  CHECK(late.Late);
+  CHECK(app->Eval("frames").AsInt() == 1);
+
+  // one thread: whatever runs first eats the budget, the rest start late
+  {
+    VQJS::Scheduler serial(1);
+    std::vector<VQJS::Ref<VQJS::Instance>> isolated;
+    for (int i = 0; i < 3; i++)
+      isolated.push_back(VQJS::CreateRef<VQJS::Instance>("Serial"));
+    const auto slow = [](VQJS::Instance &) {
+      std::this_thread::sleep_for(50ms);
+    };
+    const auto partial = serial.Frame(
+        isolated, slow, VQJS::Scheduler::Clock::now() + 20ms);
+    CHECK(partial.Completed == 1);
+    CHECK(partial.Skipped == 2);
+    CHECK(partial.Failed == 0);
+    CHECK(partial.Late);
+
+    // a Frame from inside a task would wait on itself
+    VQJS::Scheduler::FrameResult nested;
+    serial.Post(isolated[0], [&](VQJS::Instance &) {
+      nested = serial.Frame(isolated, count,
+                            VQJS::Scheduler::Clock::now() + 10s);
+    });
+    serial.Wait();
+    CHECK(nested.Completed == 0);
+    CHECK(nested.Skipped == isolated.size());
+  }
+
+  // throwing tasks are counted, the strand keeps going
+  {
+    const auto thrower = [](VQJS::Instance &) {
+      throw std::runtime_error("task failed");
+    };
+    scheduler.Post(app, thrower);
+    scheduler.Post(app, [](VQJS::Instance &self) {
+      (void)self.Eval("globalThis.after = true;");
+    });
+    scheduler.Wait();
+    CHECK(scheduler.FailedCount() == 1);
+    CHECK(app->Eval("after").AsBool());
+
+    const auto failed = scheduler.Frame(
+        instances, thrower, VQJS::Scheduler::Clock::now() + 10s);
+    CHECK(failed.Failed == instances.size());
+    CHECK(failed.Completed == 0);
+    CHECK(scheduler.FailedCount() == 1 + instances.size());
+    // m_Pending went back to zero
+    scheduler.Wait();
+    const auto again = scheduler.Frame(
+        instances, count, VQJS::Scheduler::Clock::now() + 10s);
+    CHECK(again.Completed == instances.size());
+    CHECK(app->Eval("frames").AsInt() == 2);
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "Check.h"
+#include "vqjs.h"
+
+static constexpr auto Count = "globalThis.runs = (globalThis.runs ?? 0) + 1";
+
+int main() {
+  VQJS::Instance instance{"Test"};
+
+  // nothing to run, nothing to throw on
+  const VQJS::Script empty{};
+  CHECK(!empty.IsValid());
+  CHECK(!empty.Run().IsException());
+
+  // compiled once, run as often as needed
+  const auto script = instance.Compile(Count);
+  CHECK(script.IsValid());
+  CHECK(script.Run().AsInt() == 1);
+  CHECK(script.Run().AsInt() == 2);
+  auto stats = instance.GetScriptCacheStats();
+  CHECK(stats.Misses == 1 && stats.Hits == 0 && stats.Size == 1);
+
+  // same source and name hit, another name is another script
+  CHECK(instance.Eval(Count).AsInt() == 3);
+  CHECK(instance.Eval(Count, "other.js").AsInt() == 4);
+  stats = instance.GetScriptCacheStats();
+  CHECK(stats.Hits == 1 && stats.Misses == 2 && stats.Size == 2);
+
+  // syntax errors stay on the Context and are not cached
+  const auto broken = instance.Compile("let = ;");
+  CHECK(!broken.IsValid());
+  const VQJS::Value error = broken.Run();
+  CHECK(error.IsException());
+  CHECK(error.Exception()["name"].AsString() == "SyntaxError");
+  CHECK(instance.GetScriptCacheStats().Size == 2);
+
+  // least recently used are dropped first
+  instance.SetScriptCacheSize(2);
+  (void)instance.Eval("'a'");
+  (void)instance.Eval("'b'");
+  stats = instance.GetScriptCacheStats();
+  CHECK(stats.Size == 2 && stats.Evictions == 2);
+  (void)instance.Eval("'a'");
+  (void)instance.Eval("'c'");
+  stats = instance.GetScriptCacheStats();
+  CHECK(stats.Evictions == 3);
+  const size_t hits = stats.Hits;
+  CHECK(instance.Eval("'a'").AsString() == "a");
+  CHECK(instance.GetScriptCacheStats().Hits == hits + 1);
+  CHECK(instance.Eval("'b'").AsString() == "b");
+  stats = instance.GetScriptCacheStats();
+  CHECK(stats.Hits == hits + 1 && stats.Evictions == 4);
+
+  // 0 turns the cache off, scripts still run
+  instance.SetScriptCacheSize(0);
+  CHECK(instance.GetScriptCacheStats().Size == 0);
+  const size_t misses = instance.GetScriptCacheStats().Misses;
+  CHECK(instance.Eval("6 * 7").AsInt() == 42);
+  CHECK(instance.Eval("6 * 7").AsInt() == 42);
+  stats = instance.GetScriptCacheStats();
+  CHECK(stats.Misses == misses + 2 && stats.Hits == hits + 1);
+  CHECK(stats.Size == 0);
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "BufferPool.h"
+#include "Check.h"
+#include "vqjs.h"
+
+#include <cstdint>
+#include <quickjs/quickjs.h>
+
+using VQJS::BufferPool;
+
+int main() {
+  BufferPool &pool = BufferPool::Get();
+  const size_t live = pool.LiveBuffers();
+  // owned by us, JS must neither retain nor free it
+  uint8_t foreign[64]{};
+  CHECK(!pool.Owns(foreign));
+
+  {
+    VQJS::Instance instance{"Test"};
+    VQJS::Value global = instance.Global();
+    global.Set("fromBytes", global.SharedArrayBuffer(256));
+    uint8_t *pooled = pool.Allocate(128);
+    global.Set("pooled", global.PooledSharedArrayBuffer(pooled, 128));
+    global.Set("foreign", global.SharedArrayBuffer(foreign, sizeof(foreign)));
+    CHECK(!instance
+               .Eval(R"(
+globalThis.script = new SharedArrayBuffer(32);
+new Uint8Array(foreign)[0] = 7;
+new Uint8Array(pooled)[0] = 9;
+)")
+               .IsException());
+    CHECK(foreign[0] == 7);
+    CHECK(pooled[0] == 9);
+    CHECK(pool.LiveBuffers() == live + 3);
+
+    CHECK(!instance.Eval("fromBytes = pooled = foreign = script = null;")
+               .IsException());
+    JS_RunGC(instance.GetContext());
+    // only our reference on pooled is left
+    CHECK(pool.LiveBuffers() == live + 1);
+    pool.Release(pooled);
+    CHECK(pool.LiveBuffers() == live);
+
+    // still referenced when the runtime goes away
+    global.Set("kept", global.SharedArrayBuffer(512));
+    CHECK(!instance.Eval("globalThis.more = new SharedArrayBuffer(16);")
+               .IsException());
+    CHECK(pool.LiveBuffers() == live + 2);
+  }
+  CHECK(pool.LiveBuffers() == live);
+  CHECK(foreign[0] == 7);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "Check.h"
+#include "SharedBlock.h"
+#include "vqjs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class Mode : int32_t { Off, On };
+
+struct Params {
+  float gain;
+  Mode mode;
+  bool mute;
+  int8_t trim;
+  int16_t level;
+  float eq[4];
+  double time;
+};
+VQJS_REFLECT(Params, gain, mode, mute, trim, level, eq, time)
+
+int main() {
+  // offsets have to match what the compiler made of the struct
+  const auto &fields = VQJS::SharedLayout::Of<Params>();
+  CHECK(fields.size() == 7);
+  CHECK(std::string(fields[0].Name) == "gain");
+  CHECK(fields[0].Offset == offsetof(Params, gain));
+  CHECK(fields[1].Offset == offsetof(Params, mode));
+  CHECK(std::string(fields[1].View) == "Int32Array");
+  CHECK(fields[2].Offset == offsetof(Params, mute) && fields[2].Bool);
+  CHECK(fields[3].Offset == offsetof(Params, trim));
+  CHECK(std::string(fields[3].View) == "Int8Array");
+  CHECK(fields[4].Offset == offsetof(Params, level));
+  CHECK(fields[4].ElementSize == 2);
+  CHECK(fields[5].Offset == offsetof(Params, eq) && fields[5].Count == 4);
+  CHECK(fields[6].Offset == offsetof(Params, time));
+  CHECK(std::string(fields[6].View) == "Float64Array");
+
+  const size_t live = VQJS::BufferPool::Get().LiveBuffers();
+  {
+    VQJS::Instance instance{"Test"};
+    VQJS::Value global = instance.Global();
+
+    const auto params = VQJS::CreateRef<VQJS::SharedBlock<Params>>();
+    params->Data() = {0.5f, Mode::On, true, -2, -300, {1, 2, 3, 4}, 1.25};
+    global.Set("params", VQJS::SharedBlock<Params>::Bind(params, global));
+    CHECK(instance
+              .Eval(R"(
+params.gain === 0.5 && params.mode === 1 && params.mute === true &&
+  params.trim === -2 && params.level === -300 && params.eq[3] === 4 &&
+  params.time === 1.25
+)")
+              .AsBool());
+    CHECK(!instance
+               .Eval("params.gain = 2; params.mute = false; params.level = 7;"
+                     "params.eq[0] = 9; params.time = -1;")
+               .IsException());
+    const Params &data = params->Data();
+    CHECK(data.gain == 2 && !data.mute && data.level == 7);
+    CHECK(data.eq[0] == 9 && data.eq[1] == 2 && data.time == -1);
+    CHECK(data.mode == Mode::On && data.trim == -2);
+
+    const auto buffered = VQJS::CreateRef<VQJS::BufferedBlock<Params>>();
+    global.Set("buffered",
+               VQJS::BufferedBlock<Params>::Bind(buffered, global));
+    CHECK(!instance.Eval("buffered.update()").AsBool());
+    buffered->Back().gain = 1;
+    buffered->Back().eq[2] = 5;
+    buffered->Publish();
+    // the back copy starts with the published values
+    CHECK(buffered->Back().eq[2] == 5);
+    buffered->Back().gain = 3;
+    buffered->Back().time = 8;
+    buffered->Publish();
+    CHECK(instance
+              .Eval(R"(
+buffered.update() && buffered.gain === 3 && buffered.eq[2] === 5 &&
+  buffered.time === 8 && !buffered.update()
+)")
+              .AsBool());
+  }
+  // the buffers got their references back, the blocks are gone as well
+  CHECK(VQJS::BufferPool::Get().LiveBuffers() == live);
+  return 0;
+}
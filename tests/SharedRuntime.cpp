@@ -0,0 +1,50 @@
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+int main() {
+  const TestDir dir("shared-runtime");
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetLoader().Add("@", dir.Path);
+  CHECK(runtime.Start());
+
+  VQJS::Instance &app = runtime.GetInstance();
+  CHECK(!app.Eval("globalThis.shared = {count: 1}").IsException());
+  const auto plugin = runtime.CreateInstance("Plugin");
+  CHECK(plugin->GetName() == "Plugin");
+
+  // own globals, prepared like the app
+  CHECK(plugin->Eval("typeof shared").AsString() == "undefined");
+  CHECK(plugin
+            ->Eval("typeof console.log === 'function' && "
+                   "typeof Worker === 'function'")
+            .AsBool());
+
+  // one runtime, so objects can be handed over and there is one heap
+  plugin->Global().Set("shared", app.Global()["shared"]);
+  CHECK(plugin->Eval("++shared.count").AsInt() == 2);
+  CHECK(app.Eval("shared.count").AsInt() == 2);
+  CHECK(app.GetHeapStats().LiveBytes == plugin->GetHeapStats().LiveBytes);
+  CHECK(app.GetHeapStats().TotalAllocations ==
+        plugin->GetHeapStats().TotalAllocations);
+
+  // the limit of the owner covers the whole runtime
+  app.SetMemoryLimit(8 * 1024 * 1024);
+  CHECK(plugin->Eval("new Array(4e6).fill(0.5).length").IsException());
+  (void)plugin->Global().Exception();
+  app.SetMemoryLimit(0);
+  CHECK(plugin->Eval("new Array(4e6).fill(0.5).length").AsInt() == 4000000);
+
+  // a sibling keeps the old runtime after a Reset, new ones get the new one
+  runtime.Reset();
+  CHECK(plugin->Eval("shared.count").AsInt() == 2);
+  CHECK(runtime.GetInstance().Eval("typeof shared").AsString() ==
+        "undefined");
+  const auto next = runtime.CreateInstance("Next");
+  next->Global().Set("fresh", runtime.GetInstance().Eval("({ok: true})"));
+  CHECK(next->Eval("fresh.ok && typeof shared === 'undefined'").AsBool());
+  CHECK(next->GetHeapStats().TotalAllocations ==
+        runtime.GetInstance().GetHeapStats().TotalAllocations);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "Check.h"
+#include "TestDir.h"
+#include "Worker.h"
+#include "vqjs.h"
+
+int main() {
+  const TestDir dir("snapshot");
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetLoader().Add("@", dir.Path);
+  CHECK(runtime.Start());
+
+  VQJS::Instance &app = runtime.GetInstance();
+  CHECK(!app.Eval(R"({
+const samples = new Float32Array([0.5, -1.25, 3]);
+const bytes = new Uint8Array(samples.buffer, 4, 4);
+const shared = new Int32Array(new SharedArrayBuffer(16));
+shared[3] = 7;
+const node = {name: "root", children: []};
+node.children.push({name: "child", parent: node});
+node.self = node;
+globalThis.state = {
+  samples, bytes, shared, node,
+  map: new Map([["a", 1], [node, samples]]),
+  set: new Set([1, "two", node]),
+  big: 1n << 70n,
+};
+})")
+              .IsException());
+
+  VQJS::Message saved;
+  CHECK(!app.SnapshotState(app.Global()["state"], saved).IsException());
+  CHECK(runtime.Reset());
+  CHECK(app.Eval("typeof state").AsString() == "undefined");
+  app.Global().Set("state", app.RestoreState(saved));
+
+  // same values, same types, same identities
+  CHECK(app.Eval(R"((() => {
+const {samples, bytes, shared, node, map, set, big} = state;
+return samples instanceof Float32Array && samples.length === 3 &&
+samples[0] === 0.5 && samples[1] === -1.25 && samples[2] === 3 &&
+bytes instanceof Uint8Array && bytes.buffer === samples.buffer &&
+bytes.byteOffset === 4 &&
+shared.buffer instanceof SharedArrayBuffer && shared[3] === 7 &&
+node.self === node && node.children[0].parent === node &&
+map instanceof Map && map.size === 2 && map.get("a") === 1 &&
+map.get(node) === samples &&
+set instanceof Set && set.size === 3 && set.has("two") && set.has(node) &&
+big === 1n << 70n;
+})())")
+            .AsBool());
+
+  // the snapshot can be restored more than once, into separate copies
+  app.Global().Set("again", app.RestoreState(saved));
+  CHECK(app.Eval("again.node !== state.node && again.node.self === "
+                 "again.node && again.samples[1] === -1.25")
+            .AsBool());
+  // the SharedArrayBuffer is the same memory in both
+  CHECK(app.Eval("again.shared[0] = 5; state.shared[0]").AsInt() == 5);
+
+  // functions can't be cloned, the exception comes back
+  VQJS::Message failed;
+  CHECK(app.SnapshotState(app.Eval("({run() {}})"), failed).IsException());
+  return 0;
+}
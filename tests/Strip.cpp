@@ -0,0 +1,94 @@
+#include "Bundle.h"
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+#include <filesystem>
+#include <string>
+
+struct Kept {
+  bool Source{false};
+  bool Lines{false};
+};
+
+static void Configure(VQJS::Runtime &runtime, const TestDir &dir,
+                      const bool strip, const bool keepLineInfo) {
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetConfig().Strip = strip;
+  runtime.GetConfig().KeepLineInfo = keepLineInfo;
+  runtime.GetLoader().Add("@", dir.Path);
+}
+
+static Kept Inspect(VQJS::Runtime &runtime) {
+  CHECK(!runtime.LoadFile("main.js").IsException());
+  VQJS::Instance &app = runtime.GetInstance();
+  const VQJS::Value failed = app.Eval("fail()");
+  CHECK(failed.IsException());
+  return {app.Eval("answer.toString()").AsString().find("41 + 1") !=
+              std::string::npos,
+          failed.Exception().ExceptionStack().find("lib.js:3") !=
+              std::string::npos};
+}
+
+int main() {
+  const TestDir dir("strip");
+  // throws on line 3
+  dir.Write("lib.js", R"(export function fail() {
+  const message = "failed";
+  throw new Error(message);
+}
+export function answer() { return 41 + 1; }
+)");
+  dir.Write("main.js", R"(
+import {fail, answer} from "@/lib.js";
+globalThis.fail = fail;
+globalThis.answer = answer;
+)");
+
+  struct Case {
+    bool Strip;
+    bool KeepLineInfo;
+    Kept Expected;
+    const char *Bundle;
+  };
+  const Case cases[] = {{false, false, {true, true}, "full.vqjsb"},
+                        {true, false, {false, false}, "stripped.vqjsb"},
+                        {true, true, {false, true}, "lines.vqjsb"}};
+
+  // compiled live
+  for (const auto &test : cases) {
+    VQJS::Runtime runtime;
+    Configure(runtime, dir, test.Strip, test.KeepLineInfo);
+    CHECK(runtime.Start());
+    const Kept kept = Inspect(runtime);
+    CHECK(kept.Source == test.Expected.Source);
+    CHECK(kept.Lines == test.Expected.Lines);
+
+    // a runtime of its own, the loaded modules wouldn't be compiled again
+    VQJS::Runtime writer;
+    Configure(writer, dir, test.Strip, test.KeepLineInfo);
+    CHECK(writer.Start());
+    CHECK(writer.WriteBundle(dir.Path + test.Bundle, {"main.js"}));
+  }
+
+  // the bundle keeps what its writer kept, whatever the loader is set to
+  std::filesystem::remove(dir.Path + "lib.js");
+  std::filesystem::remove(dir.Path + "main.js");
+  for (const auto &test : cases) {
+    VQJS::Bundle bundle;
+    CHECK(bundle.Open(dir.Path + test.Bundle));
+    CHECK(((bundle.Flags() & VQJS::Bundle::StripSource) != 0) ==
+          !test.Expected.Source);
+    CHECK(((bundle.Flags() & VQJS::Bundle::StripDebug) != 0) ==
+          !test.Expected.Lines);
+
+    VQJS::Runtime runtime;
+    Configure(runtime, dir, false, false);
+    CHECK(runtime.LoadBundle(dir.Path + test.Bundle));
+    CHECK(runtime.Start());
+    const Kept kept = Inspect(runtime);
+    CHECK(kept.Source == test.Expected.Source);
+    CHECK(kept.Lines == test.Expected.Lines);
+  }
+  return 0;
+}
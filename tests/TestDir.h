@@ -0,0 +1,24 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Fresh directory for the scripts of one test, removed again at the end
+struct TestDir {
+  explicit TestDir(const std::string &name)
+      : Path((std::filesystem::temp_directory_path() / ("vqjs-" + name))
+                 .generic_string() +
+             "/") {
+    std::filesystem::remove_all(Path);
+    std::filesystem::create_directories(Path);
+  }
+  ~TestDir() { std::filesystem::remove_all(Path); }
+  TestDir(const TestDir &) = delete;
+
+  void Write(const std::string &file, const std::string &content) const {
+    std::ofstream out(Path + file);
+    out << content;
+  }
+
+  std::string Path;
+};
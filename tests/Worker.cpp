@@ -0,0 +1,66 @@
+#include "Check.h"
+#include "TestDir.h"
+#include "vqjs.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+int main() {
+  const TestDir dir("worker");
+  dir.Write("echo.js", R"(
+onmessage = (e) => {
+  Atomics.add(new Int32Array(e.data.shared), 0, e.data.value);
+  postMessage({value: e.data.value + 1});
+};
+)");
+  dir.Write("closing.js", R"(
+onmessage = () => {
+  postMessage("bye");
+  close();
+};
+)");
+  dir.Write("main.js", R"(
+globalThis.received = [];
+const shared = new SharedArrayBuffer(16);
+globalThis.counter = new Int32Array(shared);
+const echo = new Worker("echo.js");
+echo.onmessage = (e) => {
+  received.push(e.data.value);
+  if (received.length === 3)
+    echo.terminate();
+};
+for (let i = 1; i <= 3; i++)
+  echo.postMessage({value: i, shared});
+
+// the last message comes in after close, its handler adds a worker while
+// Poll drops the closed one
+const closing = new Worker("closing.js");
+closing.onmessage = (e) => {
+  globalThis.bye = e.data;
+  globalThis.next = new Worker("closing.js");
+};
+closing.postMessage(0);
+)");
+
+  VQJS::Runtime runtime;
+  runtime.GetConfig().UseTypescript = false;
+  runtime.GetLoader().Add("@", dir.Path);
+  CHECK(runtime.Start());
+  CHECK(!runtime.LoadFile("main.js").IsException());
+
+  VQJS::Instance &app = runtime.GetInstance();
+  const auto until = std::chrono::steady_clock::now() + 10s;
+  size_t delivered = 0;
+  while (delivered < 4 && std::chrono::steady_clock::now() < until) {
+    delivered += app.Poll();
+    std::this_thread::sleep_for(1ms);
+  }
+  CHECK(delivered == 4);
+  CHECK(app.Eval("received.sort().join()").AsString() == "2,3,4");
+  CHECK(app.Eval("Atomics.load(counter, 0)").AsInt() == 6);
+  CHECK(app.Eval("bye").AsString() == "bye");
+  CHECK(app.Eval("next instanceof Worker").AsBool());
+  return 0;
+}